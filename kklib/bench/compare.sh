@@ -0,0 +1,62 @@
+#!/bin/sh
+# -----------------------------------------------------------------------------
+# Copyright 2021, Microsoft Research, Daan Leijen.
+#
+# This is free software; you can redistribute it and/or modify it under the
+# terms of the Apache License, Version 2.0. A copy of the License can be
+# found in the LICENSE file at the root of this distribution.
+# -----------------------------------------------------------------------------
+# Compare two JSON reports of `kklib-bench` and flag regressions:
+# a benchmark regresses if its time per operation increases by more than
+# the threshold (in percent, default 10), or if it allocates more.
+#
+# usage: compare.sh <baseline.json> <current.json> [threshold]
+# exits with 1 if any benchmark regressed.
+# -----------------------------------------------------------------------------
+
+if [ $# -lt 2 ]; then
+  echo "usage: $0 <baseline.json> <current.json> [threshold]" 1>&2
+  exit 2
+fi
+
+threshold="${3:-10}"
+
+awk -v threshold="$threshold" '
+  # extract the value of a field from a benchmark line
+  function field(line, key,    s) {
+    if (match(line, "\"" key "\": *[^,}]*") == 0) return ""
+    s = substr(line, RSTART, RLENGTH)
+    sub("\"" key "\": *", "", s)
+    gsub("[\" ]", "", s)
+    return s
+  }
+  /"name":/ {
+    name = field($0, "name")
+    if (FNR == NR) {
+      base_ns[name] = field($0, "ns_per_op") + 0
+      base_al[name] = field($0, "allocs_per_op") + 0
+      next
+    }
+    ns = field($0, "ns_per_op") + 0
+    al = field($0, "allocs_per_op") + 0
+    if (!(name in base_ns)) {
+      printf("%-20s %12s %12.3f %9s   new\n", name, "-", ns, "-")
+      next
+    }
+    delta = (base_ns[name] > 0 ? 100.0 * (ns - base_ns[name]) / base_ns[name] : 0)
+    status = ""
+    if (delta > threshold)   status = "REGRESSION"
+    if (al > base_al[name])  status = "REGRESSION (allocs " base_al[name] " -> " al ")"
+    if (status != "") regressions++
+    printf("%-20s %12.3f %12.3f %+8.1f%%   %s\n", name, base_ns[name], ns, delta, status)
+  }
+  FNR == 1 && FNR != NR {
+    printf("%-20s %12s %12s %9s\n", "benchmark", "base ns/op", "ns/op", "change")
+  }
+  END {
+    if (regressions > 0) {
+      printf("\n%d benchmark(s) regressed (threshold %s%%)\n", regressions, threshold)
+      exit 1
+    }
+  }
+' "$1" "$2"
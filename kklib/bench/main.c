@@ -0,0 +1,295 @@
+/*---------------------------------------------------------------------------
+  Copyright 2021, Microsoft Research, Daan Leijen.
+
+  This is free software; you can redistribute it and/or modify it under the
+  terms of the Apache License, Version 2.0. A copy of the License can be
+  found in the LICENSE file at the root of this distribution.
+---------------------------------------------------------------------------*/
+
+/*---------------------------------------------------------------------------
+  Micro benchmarks of kklib primitives.
+
+  usage: kklib-bench [--quick] [--filter=<prefix>]
+
+  Writes a JSON report to stdout with the time (ns/op) and the number of
+  allocations (allocs/op) for each benchmark. Use `compare.sh` to compare
+  two reports and flag regressions. Each benchmark is calibrated to run
+  at least 100ms (10ms with `--quick`) and we report the best of 3 runs.
+  Allocations are only counted on the calling thread.
+---------------------------------------------------------------------------*/
+#define __USE_MINGW_ANSI_STDIO 1  // so %z is valid on mingw
+#include <stdio.h>
+#include "kklib.h"
+#include "kklib/thread.h"
+
+#ifndef KK_ALLOC_STATS
+#error "the benchmarks must be compiled with KK_ALLOC_STATS defined"
+#endif
+
+// prevent the C compiler from optimizing away the benchmarked operations
+#if defined(__GNUC__)
+#define kk_bench_clobber()   __asm__ volatile("" ::: "memory")
+#elif defined(_MSC_VER)
+#include <intrin.h>
+#define kk_bench_clobber()   _ReadWriteBarrier()
+#else
+#define kk_bench_clobber()
+#endif
+
+static volatile intptr_t kk_bench_sink;
+
+
+/*---------------------------------------------------------------------------
+  Reference counting and allocation
+---------------------------------------------------------------------------*/
+
+#define BLOCK_SIZE  (kk_ssizeof(kk_block_t) + 3*kk_ssizeof(kk_box_t))
+
+static void bench_dup_drop(size_t n, kk_context_t* ctx) {
+  kk_block_t* b = kk_block_alloc(BLOCK_SIZE, 0, KK_TAG_BOX, ctx);
+  for (size_t i = 0; i < n; i++) {
+    kk_block_dup(b);
+    kk_bench_clobber();
+    kk_block_drop(b, ctx);
+    kk_bench_clobber();
+  }
+  kk_block_drop(b, ctx);
+}
+
+static void bench_dup_drop_shared(size_t n, kk_context_t* ctx) {
+  kk_block_t* b = kk_block_alloc(BLOCK_SIZE, 0, KK_TAG_BOX, ctx);
+  kk_block_mark_shared(b, ctx);  // use the atomic (slow) path
+  for (size_t i = 0; i < n; i++) {
+    kk_block_dup(b);
+    kk_bench_clobber();
+    kk_block_drop(b, ctx);
+    kk_bench_clobber();
+  }
+  kk_block_drop(b, ctx);
+}
+
+static void bench_alloc_free(size_t n, kk_context_t* ctx) {
+  for (size_t i = 0; i < n; i++) {
+    kk_block_t* b = kk_block_alloc(BLOCK_SIZE, 0, KK_TAG_BOX, ctx);
+    kk_bench_clobber();
+    kk_block_drop(b, ctx);
+  }
+}
+
+static void bench_alloc_reuse(size_t n, kk_context_t* ctx) {
+  kk_block_t* b = kk_block_alloc(BLOCK_SIZE, 0, KK_TAG_BOX, ctx);
+  for (size_t i = 0; i < n; i++) {
+    kk_reuse_t r = kk_block_drop_reuse(b, ctx);
+    b = kk_block_alloc_at(r, BLOCK_SIZE, 0, KK_TAG_BOX, ctx);
+    kk_bench_clobber();
+  }
+  kk_block_drop(b, ctx);
+}
+
+
+/*---------------------------------------------------------------------------
+  Integers
+---------------------------------------------------------------------------*/
+
+static void bench_int_small_add(size_t n, kk_context_t* ctx) {
+  kk_integer_t x = kk_integer_zero;
+  for (size_t i = 0; i < n; i++) {
+    x = kk_integer_add(x, kk_integer_from_small((kk_intf_t)(i & 0xFF)), ctx);
+    if (i % 1024 == 0) { kk_integer_drop(x, ctx); x = kk_integer_zero; }  // stay small
+  }
+  kk_bench_sink = (intptr_t)kk_integer_clamp32(x, ctx);
+}
+
+static void bench_int_big_mul(size_t n, kk_context_t* ctx) {
+  kk_integer_t x = kk_integer_from_str("123456789012345678901234567890123456789012345678901234567890", ctx);
+  kk_integer_t y = kk_integer_from_str("987654321098765432109876543210987654321098765432109876543210", ctx);
+  for (size_t i = 0; i < n; i++) {
+    kk_integer_t z = kk_integer_mul(kk_integer_dup(x), kk_integer_dup(y), ctx);
+    kk_bench_clobber();
+    kk_integer_drop(z, ctx);
+  }
+  kk_integer_drop(x, ctx);
+  kk_integer_drop(y, ctx);
+}
+
+static void bench_int_big_add(size_t n, kk_context_t* ctx) {
+  kk_integer_t x = kk_integer_from_str("123456789012345678901234567890123456789012345678901234567890", ctx);
+  kk_integer_t y = kk_integer_from_str("987654321098765432109876543210987654321098765432109876543210", ctx);
+  for (size_t i = 0; i < n; i++) {
+    kk_integer_t z = kk_integer_add(kk_integer_dup(x), kk_integer_dup(y), ctx);
+    kk_bench_clobber();
+    kk_integer_drop(z, ctx);
+  }
+  kk_integer_drop(x, ctx);
+  kk_integer_drop(y, ctx);
+}
+
+
+/*---------------------------------------------------------------------------
+  Strings
+---------------------------------------------------------------------------*/
+
+static kk_string_t bench_string(kk_context_t* ctx) {
+  // about 1KiB of mixed ascii and multi-byte utf-8 ending in "needle"
+  const char* part = "hello w\xC3\xB6rld \xE2\x98\x83 and some more ascii text; ";
+  const size_t plen = strlen(part);
+  char buf[1100];
+  size_t len = 0;
+  while (len + plen < 1024) {
+    memcpy(buf + len, part, plen);
+    len += plen;
+  }
+  memcpy(buf + len, "needle", 7);
+  return kk_string_alloc_from_utf8(buf, ctx);
+}
+
+static void bench_string_count(size_t n, kk_context_t* ctx) {
+  kk_string_t s = bench_string(ctx);
+  for (size_t i = 0; i < n; i++) {
+    kk_bench_sink = kk_string_count_borrow(s);
+  }
+  kk_string_drop(s, ctx);
+}
+
+static void bench_string_validate(size_t n, kk_context_t* ctx) {
+  kk_string_t s = bench_string(ctx);
+  kk_ssize_t len;
+  const uint8_t* buf = kk_string_buf_borrow(s, &len);
+  for (size_t i = 0; i < n; i++) {
+    kk_bench_sink = kk_utf8_is_validn(len, buf);
+    kk_bench_clobber();
+  }
+  kk_string_drop(s, ctx);
+}
+
+static void bench_string_search(size_t n, kk_context_t* ctx) {
+  kk_string_t s = bench_string(ctx);
+  kk_string_t sub = kk_string_alloc_from_utf8("needle", ctx);
+  for (size_t i = 0; i < n; i++) {
+    kk_bench_sink = kk_string_contains(kk_string_dup(s), kk_string_dup(sub), ctx);
+  }
+  kk_string_drop(sub, ctx);
+  kk_string_drop(s, ctx);
+}
+
+
+/*---------------------------------------------------------------------------
+  Vectors
+---------------------------------------------------------------------------*/
+
+static void bench_vector_realloc(size_t n, kk_context_t* ctx) {
+  kk_vector_t v = kk_vector_alloc(256, kk_box_null, ctx);
+  for (size_t i = 0; i < n; i++) {
+    v = kk_vector_realloc(v, ((i&1)==0 ? 257 : 256), kk_box_null, ctx);
+  }
+  kk_vector_drop(v, ctx);
+}
+
+
+/*---------------------------------------------------------------------------
+  Tasks
+---------------------------------------------------------------------------*/
+
+static kk_box_t bench_task_fun(kk_function_t self, kk_context_t* ctx) {
+  kk_function_drop(self, ctx);
+  return kk_integer_box(kk_integer_one);
+}
+
+static void bench_task_spawn_await(size_t n, kk_context_t* ctx) {
+  kk_define_static_function(fun, bench_task_fun, ctx);
+  for (size_t i = 0; i < n; i++) {
+    kk_promise_t p = kk_task_schedule(kk_function_dup(fun), ctx);
+    kk_box_t r = kk_promise_get(p, ctx);
+    kk_box_drop(r, ctx);
+  }
+}
+
+
+/*---------------------------------------------------------------------------
+  Benchmark runner
+---------------------------------------------------------------------------*/
+
+typedef struct bench_s {
+  const char* name;
+  void (*run)(size_t n, kk_context_t* ctx);
+} bench_t;
+
+static const bench_t benches[] = {
+  { "dup-drop",            &bench_dup_drop },
+  { "dup-drop-shared",     &bench_dup_drop_shared },
+  { "alloc-free",          &bench_alloc_free },
+  { "alloc-reuse",         &bench_alloc_reuse },
+  { "int-small-add",       &bench_int_small_add },
+  { "int-big-add",         &bench_int_big_add },
+  { "int-big-mul",         &bench_int_big_mul },
+  { "string-count",        &bench_string_count },
+  { "string-validate",     &bench_string_validate },
+  { "string-search",       &bench_string_search },
+  { "vector-realloc",      &bench_vector_realloc },
+  { "task-spawn-await",    &bench_task_spawn_await },
+  { NULL, NULL }
+};
+
+static double bench_now(kk_context_t* ctx) {
+  double frac;
+  double secs = kk_timer_ticks(&frac, ctx);
+  return (secs + frac);
+}
+
+// run `n` iterations and return the elapsed seconds and allocation count
+static double bench_run(const bench_t* b, size_t n, size_t* allocs, kk_context_t* ctx) {
+  const size_t count = kk_alloc_count;
+  const double start = bench_now(ctx);
+  (b->run)(n, ctx);
+  const double elapsed = bench_now(ctx) - start;
+  *allocs = kk_alloc_count - count;
+  return elapsed;
+}
+
+static void bench_report(const bench_t* b, double min_secs, bool first, kk_context_t* ctx) {
+  // calibrate
+  size_t n = 16;
+  size_t allocs = 0;
+  double secs = bench_run(b, n, &allocs, ctx);
+  while (secs < min_secs && n < ((size_t)1 << 40)) {
+    n = (secs <= 0 ? 16*n : (size_t)((double)n * (1.2 * min_secs / secs)) + 1);
+    secs = bench_run(b, n, &allocs, ctx);
+  }
+  // best of 3
+  for (int i = 0; i < 2; i++) {
+    size_t allocs2;
+    double secs2 = bench_run(b, n, &allocs2, ctx);
+    if (secs2 < secs) { secs = secs2; }
+  }
+  printf("%s    { \"name\": \"%s\", \"iterations\": %zu, \"ns_per_op\": %.3f, \"allocs_per_op\": %.3f }",
+         (first ? "" : ",\n"), b->name, n, (secs * 1e9) / (double)n, (double)allocs / (double)n);
+  fflush(stdout);
+}
+
+int main(int argc, char** argv) {
+  kk_context_t* ctx = kk_main_start(argc, argv);
+  double min_secs = 0.1;
+  const char* filter = NULL;
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--quick") == 0) {
+      min_secs = 0.01;
+    }
+    else if (strncmp(argv[i], "--filter=", 9) == 0) {
+      filter = argv[i] + 9;
+    }
+    else {
+      fprintf(stderr, "usage: %s [--quick] [--filter=<prefix>]\n", argv[0]);
+      return 1;
+    }
+  }
+  printf("{\n  \"kklib_build\": %d,\n  \"benchmarks\": [\n", KKLIB_BUILD);
+  bool first = true;
+  for (const bench_t* b = benches; b->name != NULL; b++) {
+    if (filter != NULL && strncmp(b->name, filter, strlen(filter)) != 0) continue;
+    bench_report(b, min_secs, first, ctx);
+    first = false;
+  }
+  printf("\n  ]\n}\n");
+  kk_main_end(ctx);
+  return 0;
+}
@@ -2,7 +2,7 @@
 #ifndef KKLIB_H
 #define KKLIB_H
 
-#define KKLIB_BUILD        55       // modify on changes to trigger recompilation
+#define KKLIB_BUILD        83       // modify on changes to trigger recompilation
 #define KK_MULTI_THREADED   1       // set to 0 to be used single threaded only
 // #define KK_DEBUG_FULL       1
 
@@ -64,6 +64,10 @@ typedef enum kk_tag_e {
   KK_TAG_CFUNPTR,     // C function pointer
   KK_TAG_INTPTR,      // boxed intptr_t  
   KK_TAG_EVV_VECTOR,  // evidence vector (used in std/core/hnd)
+  KK_TAG_ARRAY,       // array of unboxed values (int32_t, int64_t, double, or uint8_t)
+  KK_TAG_BYTES_ROPE,  // concatenation of two byte sequences (see `bytes.c`)
+  KK_TAG_BYTES_VIEW,  // a range of bytes in a parent byte sequence (see `bytes.c`)
+  KK_TAG_BYTES_BUILDER, // a bytes buffer with spare capacity (see `bytes.c`)
   // raw tags have a free function together with a `void*` to the data
   KK_TAG_CPTR_RAW,    // full void* (must be first, see kk_tag_is_raw())
   KK_TAG_BYTES_RAW,   // pointer to byte buffer
@@ -71,7 +75,9 @@ typedef enum kk_tag_e {
   // strings are represented by bytes but guarantee valid utf-8 encoding
   KK_TAG_STRING_SMALL = KK_TAG_BYTES_SMALL, // utf-8 encoded string of at most 7 bytes.
   KK_TAG_STRING       = KK_TAG_BYTES,       // utf-8 encoded string ending with a zero byte.
-  KK_TAG_STRING_RAW   = KK_TAG_BYTES_RAW    // pointer to a valid utf-8 string
+  KK_TAG_STRING_RAW   = KK_TAG_BYTES_RAW,   // pointer to a valid utf-8 string
+  KK_TAG_STRING_ROPE  = KK_TAG_BYTES_ROPE,  // concatenation of two strings
+  KK_TAG_STRING_VIEW  = KK_TAG_BYTES_VIEW   // a substring of a parent string
 } kk_tag_t;
 
 static inline bool kk_tag_is_raw(kk_tag_t tag) {
@@ -323,6 +329,7 @@ typedef struct kk_context_s {
   kk_task_group_t* task_group;     // task group for managing threads. NULL for the main thread.
 
   struct kk_random_ctx_s* srandom_ctx; // strong random using chacha20, initialized on demand
+  struct kk_async_s* async;        // asynchronous I/O queue, initialized on demand
   kk_ssize_t     argc;             // command line argument count 
   const char**   argv;             // command line arguments
   kk_timer_t     process_start;    // time at start of the process
@@ -339,6 +346,7 @@ kk_decl_export void          kk_free_context(void);
 
 kk_decl_export kk_context_t* kk_main_start(int argc, char** argv);
 kk_decl_export void          kk_main_end(kk_context_t* ctx);
+kk_decl_export int           kk_main_run(int argc, char** argv, int (*main_fun)(int argc, char** argv));
 
 kk_decl_export void          kk_debugger_break(kk_context_t* ctx);
 
@@ -370,33 +378,47 @@ static inline int32_t kk_marker_unique(kk_context_t* ctx) {
 
 kk_decl_export void kk_block_mark_shared( kk_block_t* b, kk_context_t* ctx );
 kk_decl_export void kk_box_mark_shared( kk_box_t b, kk_context_t* ctx );
+kk_decl_export void kk_block_make_sticky( kk_block_t* b );
 
 /*--------------------------------------------------------------------------------------
   Allocation
 --------------------------------------------------------------------------------------*/
 
+#ifdef KK_ALLOC_STATS
+// count allocations per thread (used by the benchmarks in `kklib/bench`)
+extern kk_decl_thread size_t kk_alloc_count;
+#define kk_alloc_stats_count()   (kk_alloc_count++)
+#else
+#define kk_alloc_stats_count()
+#endif
+
 #ifdef KK_MIMALLOC
 #ifdef KK_MIMALLOC_INLINE
   static inline void* kk_malloc_small(kk_ssize_t sz, kk_context_t* ctx) {
+    kk_alloc_stats_count();
     return kk_mi_heap_malloc_small_inline(ctx->heap, (size_t)sz);
   }
 #else
   static inline void* kk_malloc_small(kk_ssize_t sz, kk_context_t* ctx) {
+    kk_alloc_stats_count();
     return mi_heap_malloc_small(ctx->heap, (size_t)sz);
   } 
 #endif
 
 static inline void* kk_malloc(kk_ssize_t sz, kk_context_t* ctx) {
+  kk_alloc_stats_count();
   return mi_heap_malloc(ctx->heap, (size_t)sz);
 }
 
 static inline void* kk_zalloc(kk_ssize_t sz, kk_context_t* ctx) {
   KK_UNUSED(ctx);
+  kk_alloc_stats_count();
   return mi_heap_zalloc(ctx->heap, (size_t)sz);
 }
 
 static inline void* kk_realloc(void* p, kk_ssize_t sz, kk_context_t* ctx) {
   KK_UNUSED(ctx);
+  kk_alloc_stats_count();
   return mi_heap_realloc(ctx->heap, p, (size_t)sz);
 }
 
@@ -407,9 +429,14 @@ static inline void kk_free(const void* p) {
 static inline void kk_free_local(const void* p) {
   kk_free(p);
 }
+
+static inline kk_ssize_t kk_malloc_usable_size(const void* p) {
+  return (kk_ssize_t)mi_usable_size(p);
+}
 #else
 static inline void* kk_malloc(kk_ssize_t sz, kk_context_t* ctx) {
   KK_UNUSED(ctx);
+  kk_alloc_stats_count();
   return malloc((size_t)sz);
 }
 
@@ -419,11 +446,13 @@ static inline void* kk_malloc_small(kk_ssize_t sz, kk_context_t* ctx) {
 
 static inline void* kk_zalloc(kk_ssize_t sz, kk_context_t* ctx) {
   KK_UNUSED(ctx);
+  kk_alloc_stats_count();
   return calloc(1, (size_t)sz);
 }
 
 static inline void* kk_realloc(void* p, kk_ssize_t sz, kk_context_t* ctx) {
   KK_UNUSED(ctx);
+  kk_alloc_stats_count();
   return realloc(p, (size_t)sz);
 }
 
@@ -435,6 +464,12 @@ static inline void kk_free(const void* p) {
 static inline void kk_free_local(const void* p) {
   kk_free(p);
 }
+
+// the usable size is unknown without mimalloc (0)
+static inline kk_ssize_t kk_malloc_usable_size(const void* p) {
+  KK_UNUSED(p);
+  return 0;
+}
 #endif
 
 
@@ -468,7 +503,9 @@ static inline kk_block_t* kk_block_alloc_at(kk_reuse_t at, kk_ssize_t size, kk_s
     b = (kk_block_t*)kk_malloc_small(size, ctx);
   }
   else {
-    kk_assert_internal(kk_block_is_unique(at)); // TODO: check usable size of `at`
+    // `at` may come from a different (larger) constructor (see `Backend/C/ParcReuse.hs`)
+    kk_assert_internal(kk_block_is_unique(at));
+    kk_assert_internal(kk_malloc_usable_size(at) == 0 || kk_malloc_usable_size(at) >= size);
     b = at;
   }
   kk_block_init(b, size, scan_fsize, tag);
@@ -543,7 +580,7 @@ static inline kk_block_t* kk_block_dup(kk_block_t* b) {
 static inline void kk_block_drop(kk_block_t* b, kk_context_t* ctx) {
   kk_assert_internal(kk_block_is_valid(b));
   const uint32_t rc = b->header.refcount;
-  if ((int32_t)(rc > 0)) {          // note: assume two's complement
+  if ((int32_t)rc > 0) {            // note: assume two's complement
     b->header.refcount = rc-1;
   }
   else {
@@ -554,7 +591,7 @@ static inline void kk_block_drop(kk_block_t* b, kk_context_t* ctx) {
 static inline void kk_block_decref(kk_block_t* b, kk_context_t* ctx) {
   kk_assert_internal(kk_block_is_valid(b));
   const uint32_t rc = b->header.refcount;  
-  if (kk_likely((int32_t)(rc > 0))) {     // note: assume two's complement
+  if (kk_likely((int32_t)rc > 0)) {       // note: assume two's complement
     b->header.refcount = rc - 1;
   }
   else {
@@ -889,6 +926,9 @@ typedef enum kk_unit_e {
 #include "kklib/random.h"
 #include "kklib/os.h"
 #include "kklib/thread.h"
+#include "kklib/async.h"
+#include "kklib/simd.h"
+#include "kklib/hashtable.h"
 
 /*----------------------------------------------------------------------
   TLD operations
@@ -996,13 +1036,17 @@ static inline kk_vector_t kk_vector_dup(kk_vector_t v) {
   return kk_datatype_dup(v);
 }
 
+static inline kk_ssize_t kk_vector_alloc_size(kk_ssize_t length) {
+  return (kk_ssizeof(struct kk_vector_large_s) + (length-1)*kk_ssizeof(kk_box_t));
+}
+
 static inline kk_vector_t kk_vector_alloc_uninit(kk_ssize_t length, kk_box_t** buf, kk_context_t* ctx) {
   if (kk_unlikely(length<=0)) {
     if (buf != NULL) *buf = NULL;
     return kk_vector_empty();
   }
   else {
-    kk_vector_large_t v = (kk_vector_large_t)kk_block_large_alloc(kk_ssizeof(struct kk_vector_large_s) + (length-1)*kk_ssizeof(kk_box_t), length + 1 /* kk_large_scan_fsize */, KK_TAG_VECTOR, ctx);
+    kk_vector_large_t v = (kk_vector_large_t)kk_block_large_alloc(kk_vector_alloc_size(length), length + 1 /* kk_large_scan_fsize */, KK_TAG_VECTOR, ctx);
     if (buf != NULL) *buf = &v->vec[0];
     return kk_datatype_from_base(&v->_base);
   }
@@ -1011,6 +1055,11 @@ static inline kk_vector_t kk_vector_alloc_uninit(kk_ssize_t length, kk_box_t** b
 kk_decl_export void        kk_vector_init_borrow(kk_vector_t _v, kk_ssize_t start, kk_box_t def, kk_context_t* ctx);
 kk_decl_export kk_vector_t kk_vector_realloc(kk_vector_t vec, kk_ssize_t newlen, kk_box_t def, kk_context_t* ctx);
 kk_decl_export kk_vector_t kk_vector_copy(kk_vector_t vec, kk_context_t* ctx);
+kk_decl_export kk_vector_t kk_vector_push(kk_vector_t vec, kk_box_t x, kk_context_t* ctx);
+kk_decl_export kk_vector_t kk_vector_builder_push(kk_vector_t vec, kk_ssize_t count, kk_box_t x, kk_context_t* ctx);
+kk_decl_export kk_vector_t kk_vector_update(kk_vector_t vec, kk_ssize_t i, kk_box_t x, kk_context_t* ctx);
+kk_decl_export kk_vector_t kk_vector_insert(kk_vector_t vec, kk_ssize_t i, kk_box_t x, kk_context_t* ctx);
+kk_decl_export kk_vector_t kk_vector_remove(kk_vector_t vec, kk_ssize_t i, kk_context_t* ctx);
 
 static inline kk_vector_t kk_vector_alloc(kk_ssize_t length, kk_box_t def, kk_context_t* ctx) {
   kk_vector_t v = kk_vector_alloc_uninit(length, NULL, ctx);
@@ -1063,7 +1112,7 @@ static inline kk_vector_t kk_vector_unbox(kk_box_t v, kk_context_t* ctx) {
 }
 
 
- 
+
 /*--------------------------------------------------------------------------------------
   References
 --------------------------------------------------------------------------------------*/
@@ -1139,6 +1188,79 @@ static inline kk_box_t kk_ref_modify(kk_ref_t r, kk_function_t f, kk_context_t*
   return kk_function_call(kk_box_t,(kk_function_t,kk_ref_t,kk_context_t*),f,(f,r,ctx));
 }
 
+/*--------------------------------------------------------------------------------------
+  Unboxed arrays
+  An array of primitive values (`int32_t`, `int64_t`, `double`, or `uint8_t`) stored
+  as raw data after the header (so `scan_fsize == 0` and freeing is O(1)).
+  Arrays are boxed as plain pointers; the element type is only known statically.
+  An array is updated in-place when it is unique and copied otherwise.
+--------------------------------------------------------------------------------------*/
+
+typedef struct kk_array_s {
+  kk_block_t  _block;
+  kk_ssize_t  length;       // number of elements
+  kk_ssize_t  elem_size;    // size of an element in bytes
+  int64_t     buf[1];       // raw element data (aligned for 8-byte elements)
+} *kk_array_t;
+
+static inline kk_array_t kk_array_unbox_borrow(kk_box_t a) {
+  return kk_block_assert(kk_array_t, kk_ptr_unbox(a), KK_TAG_ARRAY);
+}
+
+static inline kk_ssize_t kk_array_len_borrow(kk_box_t a) {
+  return kk_array_unbox_borrow(a)->length;
+}
+
+static inline void* kk_array_buf_borrow(kk_box_t a, kk_ssize_t* len) {
+  kk_array_t arr = kk_array_unbox_borrow(a);
+  if (len != NULL) *len = arr->length;
+  return &arr->buf[0];
+}
+
+kk_decl_export kk_box_t kk_array_alloc(kk_ssize_t length, kk_ssize_t elem_size, void** buf, kk_context_t* ctx);
+kk_decl_export kk_box_t kk_array_realloc(kk_box_t a, kk_ssize_t newlen, kk_context_t* ctx);
+kk_decl_export kk_box_t kk_array_copy(kk_box_t a, kk_context_t* ctx);
+// Ensure the reference holds a unique array (for in-place assignment) and return it (borrowed).
+kk_decl_export kk_box_t kk_ref_array_unique_borrow(kk_ref_t r, kk_context_t* ctx);
+
+static inline kk_box_t kk_array_ensure_unique(kk_box_t a, kk_context_t* ctx) {
+  return (kk_likely(kk_block_is_unique(kk_ptr_unbox(a))) ? a : kk_array_copy(a, ctx));
+}
+
+#define kk_array_define(tp,name) \
+  static inline kk_box_t kk_array_##name##_alloc(kk_ssize_t length, tp init, kk_context_t* ctx) { \
+    tp* buf; \
+    kk_box_t a = kk_array_alloc(length, kk_ssizeof(tp), (void**)&buf, ctx); \
+    for (kk_ssize_t i = 0; i < length; i++) { buf[i] = init; } \
+    return a; \
+  } \
+  static inline tp* kk_array_##name##_buf_borrow(kk_box_t a, kk_ssize_t* len) { \
+    kk_assert_internal(kk_array_unbox_borrow(a)->elem_size == kk_ssizeof(tp)); \
+    return (tp*)kk_array_buf_borrow(a, len); \
+  } \
+  static inline tp kk_array_##name##_at_borrow(kk_box_t a, kk_ssize_t i) { \
+    kk_assert(i >= 0 && i < kk_array_len_borrow(a)); \
+    return kk_array_##name##_buf_borrow(a, NULL)[i]; \
+  } \
+  static inline kk_box_t kk_array_##name##_set(kk_box_t a, kk_ssize_t i, tp x, kk_context_t* ctx) { \
+    a = kk_array_ensure_unique(a, ctx); \
+    kk_assert(i >= 0 && i < kk_array_len_borrow(a)); \
+    kk_array_##name##_buf_borrow(a, NULL)[i] = x; \
+    return a; \
+  } \
+  static inline kk_unit_t kk_ref_array_##name##_assign_borrow(kk_ref_t r, kk_ssize_t i, tp x, kk_context_t* ctx) { \
+    kk_box_t a = kk_ref_array_unique_borrow(r, ctx); \
+    kk_assert(i >= 0 && i < kk_array_len_borrow(a)); \
+    kk_array_##name##_buf_borrow(a, NULL)[i] = x; \
+    return kk_Unit; \
+  }
+
+kk_array_define(int32_t, int32)
+kk_array_define(int64_t, int64)
+kk_array_define(double, double)
+kk_array_define(uint8_t, byte)
+
+
 /*--------------------------------------------------------------------------------------
   kk_Unit
 --------------------------------------------------------------------------------------*/
@@ -0,0 +1,69 @@
+#pragma once
+#ifndef KK_ASYNC_H
+#define KK_ASYNC_H
+/*---------------------------------------------------------------------------
+  Copyright 2021, Microsoft Research, Daan Leijen.
+
+  This is free software; you can redistribute it and/or modify it under the
+  terms of the Apache License, Version 2.0. A copy of the License can be
+  found in the LICENSE file at the root of this distribution.
+---------------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------------------------
+  Event loop
+
+  Each thread has an event loop that is driven by `kk_async_poll`. Callbacks are Koka
+  functions that usually resume a continuation suspended by an `await` in `std/async`.
+--------------------------------------------------------------------------------------*/
+
+struct kk_async_s;
+
+// Invoke completed requests, ready callbacks, and expired timers. If `wait` is true and nothing
+// was ready, block until the next event (or the first timer is due).
+// Returns the number of outstanding requests, timers, watches, and ready callbacks.
+kk_decl_export kk_ssize_t kk_async_poll( bool wait, kk_context_t* ctx );
+
+// Invoke `callback()` after `ms` milli-seconds. Returns an identifier for `kk_async_clear_timeout`.
+kk_decl_export int64_t    kk_async_set_timeout( int64_t ms, kk_function_t callback, kk_context_t* ctx );
+kk_decl_export bool       kk_async_clear_timeout( int64_t id, kk_context_t* ctx );
+
+// Invoke `callback()` on the next poll.
+kk_decl_export void       kk_async_post( kk_function_t callback, kk_context_t* ctx );
+
+// Invoke `callback(err : int32)` once `fd` is ready for reading (or writing). Uses `epoll` (Linux only).
+kk_decl_export void       kk_async_watch_fd( int fd, bool write, kk_function_t callback, kk_context_t* ctx );
+
+// Remember the first exception of a detached computation (to be raised by `async-handle`).
+kk_decl_export void       kk_async_set_failure( kk_box_t exn, kk_context_t* ctx );
+kk_decl_export kk_box_t   kk_async_take_failure( kk_context_t* ctx );
+
+kk_decl_export void       kk_async_free( kk_context_t* ctx );
+
+
+/*--------------------------------------------------------------------------------------
+  Asynchronous file I/O
+
+  Reads and writes are submitted to a per-thread queue and complete out of order.
+  On Linux the requests go to an `io_uring` submission queue; elsewhere (or when
+  `io_uring` is not available) a small pool of worker threads performs them
+  with `pread`/`pwrite`. Completed requests are reaped by `kk_async_poll` on the
+  thread that submitted them, which then calls the request callback as
+  `callback(err : int32, count : ssize_t, data : string)` where `err` is an errno
+  error code (or 0), `count` the bytes transferred and `data` the text read.
+--------------------------------------------------------------------------------------*/
+
+// Open a file for asynchronous reading (or writing if `write` is true, truncating an existing file).
+kk_decl_export int  kk_async_file_open( kk_string_t path, bool write, kk_box_t* file, kk_context_t* ctx );
+kk_decl_export int  kk_async_file_size( kk_box_t file, int64_t* size, kk_context_t* ctx );
+// Close a file; if requests are still outstanding the file is closed when the last one completes.
+kk_decl_export int  kk_async_file_close( kk_box_t file, kk_context_t* ctx );
+
+// Read `len` bytes at `offset`; large reads are split in requests of at most `chunk` bytes that run concurrently.
+kk_decl_export void kk_async_read( kk_box_t file, int64_t offset, kk_ssize_t len, kk_ssize_t chunk, kk_function_t callback, kk_context_t* ctx );
+// Write `s` at `offset`; large writes are split in requests of at most `chunk` bytes that run concurrently.
+kk_decl_export void kk_async_write( kk_box_t file, int64_t offset, kk_string_t s, kk_ssize_t chunk, kk_function_t callback, kk_context_t* ctx );
+
+// Is `io_uring` used for asynchronous I/O on this thread?
+kk_decl_export bool kk_async_uses_uring( kk_context_t* ctx );
+
+#endif // include guard
@@ -517,5 +517,18 @@ static inline uint8_t kk_bits_digits(kk_uintx_t x) {
   return kk_bitsx(digits)(x);
 }
 
+/* ---------------------------------------------------------------
+  Mix the bits of a value (the `splitmix64` finalizer) such that
+  every input bit affects every output bit; used for hashing.
+------------------------------------------------------------------ */
+static inline uint64_t kk_bits_mix64(uint64_t x) {
+  x ^= (x >> 30);
+  x *= KU64(0xBF58476D1CE4E5B9);
+  x ^= (x >> 27);
+  x *= KU64(0x94D049BB133111EB);
+  x ^= (x >> 31);
+  return x;
+}
+
 
 #endif // include guard
@@ -391,7 +391,13 @@ typedef struct kk_boxed_value_s {
 
 #define kk_valuetype_unbox_(tp,p,x,box,ctx) \
   do { \
-    if (kk_unlikely(kk_box_is_any(box))) { \
+    if (kk_box_is_value(box)) { \
+      /* small value type stored directly in the box (see `kk_valuetype_box_small`) */ \
+      p = NULL; \
+      kk_uintf_t _u = kk_shrf(_kk_box_value(box), 1); \
+      memcpy(&x, &_u, (sizeof(tp) < sizeof(_u) ? sizeof(tp) : sizeof(_u))); \
+    } \
+    else if (kk_unlikely(kk_box_is_any(box))) { \
       p = NULL; \
       const size_t kk__max_scan_fsize = sizeof(tp)/sizeof(kk_box_t); \
       kk_box_t* _fields = (kk_box_t*)(&x); \
@@ -412,6 +418,26 @@ typedef struct kk_boxed_value_s {
     x = kk_basetype_box(p); \
   } while(0)
 
+// Box a value type without any scan fields. If the value fits in a boxed value
+// we store it directly in the box without allocating (the size check is constant
+// and folded by the C compiler).
+#if KK_ARCH_LITTLE_ENDIAN
+#define kk_valuetype_box_small(tp,x,val,ctx)  \
+  do { \
+    if (sizeof(tp) < sizeof(kk_uintf_t)) { \
+      const tp valx = val; \
+      kk_uintf_t _u = 0; \
+      memcpy(&_u, &valx, (sizeof(tp) < sizeof(kk_uintf_t) ? sizeof(tp) : 0)); \
+      x = _kk_box_new_value((_u << 1) | 1); \
+    } \
+    else { \
+      kk_valuetype_box(tp,x,val,0,ctx); \
+    } \
+  } while(0)
+#else
+#define kk_valuetype_box_small(tp,x,val,ctx)  kk_valuetype_box(tp,x,val,0,ctx)
+#endif
+
 // `box_any` is used to return when yielding 
 // (and should be accepted by any unbox operation, and also dup/drop operations. That is why we use a ptr)
 static inline kk_box_t kk_box_any(kk_context_t* ctx) {
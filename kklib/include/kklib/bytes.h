@@ -11,12 +11,21 @@
 
 /*---------------------------------------------------------------------------------------------------------------
   Bytes.
-  There are four possible representations for bytes:
+  There are six possible representations for bytes:
   
   - singleton empty bytes
   - small byte sequence of at most 7 bytes (ending in a zero byte not included in the length)
   - normal sequence of bytes (ending in a zero byte not included in the length)
   - raw bytes, pointing to an (external) sequence of bytes.
+  - rope bytes, the concatenation of two (non-empty) bytes. Long concatenations create ropes 
+    (see `kk_bytes_cat`) which are kept balanced, such that repeated concatenation takes 
+    logarithmic time. A rope is flattened into a normal sequence of bytes the first time
+    `kk_bytes_buf_borrow` is called on it; use `kk_bytes_foreach_chunk_borrow` to traverse 
+    the bytes without flattening.
+  - view bytes, a range of bytes in a (non-view) parent that is kept alive by the view. Views 
+    are created by `kk_bytes_view` (used for splitting and slicing) so taking a substring 
+    takes constant time. Since a view is not zero terminated in general, `kk_bytes_buf_borrow` 
+    does not guarantee a terminating zero; use `kk_bytes_cbuf_borrow` for a C string.
   
   These are not necessarily canonical (e.g. a normal or small bytes can have length 0 instead of being an empty singleton)
 -------------------------------------------------------------------------------------------------------------*/
@@ -55,8 +64,29 @@ typedef struct kk_bytes_raw_s {
   kk_free_fun_t* free;     
   const uint8_t* cbuf;                    
   kk_ssize_t        length;
+  _Atomic(uintptr_t) flat;                // kk_bytes_t: a zero terminated copy (see `kk_bytes_cbuf_borrow`), or empty
 } *kk_bytes_raw_t;
 
+typedef struct kk_bytes_rope_s {
+  struct kk_bytes_s  _base;
+  kk_box_t           left;      // kk_bytes_t (scanned)
+  kk_box_t           right;     // kk_bytes_t (scanned)
+  _Atomic(uintptr_t) flat;      // kk_bytes_t (scanned): the flattened bytes, or empty if not yet flattened
+  kk_ssize_t         length;
+  kk_ssize_t         depth;     // depth of the tree of ropes (to keep it balanced)
+} *kk_bytes_rope_t;
+
+typedef struct kk_bytes_view_s {
+  struct kk_bytes_s  _base;
+  kk_box_t           parent;    // kk_bytes_t (scanned): the viewed bytes
+  _Atomic(uintptr_t) flat;      // kk_bytes_t (scanned): a zero terminated copy (see `kk_bytes_cbuf_borrow`), or empty
+  const uint8_t*     cbuf;      // start of the view in the parent
+  kk_ssize_t         length;
+} *kk_bytes_view_t;
+
+// Views shorter than this are copied instead (to save space and to not keep the parent alive).
+#define KK_BYTES_VIEW_MIN  (32)
+
 // Define bytes literals
 #define kk_define_bytes_literal(decl,name,len,init) \
   static struct { struct kk_bytes_s _base; kk_ssize_t length; uint8_t buf[len+1]; } _static_##name = \
@@ -117,10 +147,50 @@ static inline kk_bytes_t kk_bytes_alloc_raw_len(kk_ssize_t len, const uint8_t* p
   br->free = (free ? &kk_free_fun : NULL);
   br->cbuf = p;
   br->length = len;
+  kk_atomic_store_relaxed(&br->flat, kk_bytes_empty().dbox);
   return kk_datatype_from_base(&br->_base);
 }
 
-// Get access to the bytes via a pointer (and retrieve the length as well)
+// Byte builders: a builder holds a normal bytes buffer with spare capacity beyond its length, and
+// the capacity of the buffer. Appending takes amortized constant time (the capacity doubles when it
+// grows) and is in-place if the builder is unique. The buffer is always valid (zero terminated) bytes.
+// The boxed empty bytes is an empty builder as well.
+// Use `kk_bytes_builder_reserve` to get a pointer to room for `extra` bytes at the end,
+// `kk_bytes_builder_advance` to extend the length with the `n <= extra` bytes that were written,
+// and `kk_bytes_builder_build` to get the final bytes (without copying if the builder is unique).
+typedef kk_box_t kk_bytes_builder_t;
+
+typedef struct kk_bytes_builder_s {
+  struct kk_bytes_s  _base;
+  kk_box_t           buf;       // kk_bytes_t (scanned): normal bytes
+  kk_ssize_t         capacity;  // bytes allocated for `buf` (including the terminating zero)
+} *kk_bytes_builder_block_t;
+
+static inline kk_bytes_builder_t kk_bytes_builder_empty(void) {
+  return kk_bytes_box(kk_bytes_empty());
+}
+
+kk_decl_export kk_bytes_builder_t kk_bytes_builder_reserve(kk_bytes_builder_t sb, kk_ssize_t extra, uint8_t** p, kk_context_t* ctx);
+kk_decl_export kk_bytes_t         kk_bytes_builder_build(kk_bytes_builder_t sb, kk_context_t* ctx);
+
+static inline kk_bytes_builder_t kk_bytes_builder_advance(kk_bytes_builder_t sb, kk_ssize_t n) {
+  kk_bytes_builder_block_t b = kk_datatype_as_assert(kk_bytes_builder_block_t, kk_datatype_unbox(sb), KK_TAG_BYTES_BUILDER);
+  kk_bytes_normal_t nb = kk_datatype_as_assert(kk_bytes_normal_t, kk_bytes_unbox(b->buf), KK_TAG_BYTES);
+  kk_assert_internal(kk_datatype_is_unique(kk_bytes_unbox(b->buf)) && n >= 0 && nb->length + n < b->capacity);
+  nb->length += n;
+  nb->buf[nb->length] = 0;
+  return sb;
+}
+
+kk_decl_export const uint8_t* kk_bytes_rope_buf_borrow(const kk_bytes_t b, kk_ssize_t* len);
+kk_decl_export const uint8_t* kk_bytes_copy_cbuf_borrow(const kk_bytes_t b, kk_ssize_t* len);
+kk_decl_export void           kk_bytes_raw_free_flat(kk_block_t* b, kk_context_t* ctx);
+
+// Return the `len` bytes starting at `start` in `b` as a view on `b` (or as a copy if `len` is small).
+kk_decl_export kk_bytes_t kk_bytes_view(kk_bytes_t b, kk_ssize_t start, kk_ssize_t len, kk_context_t* ctx);
+
+// Get access to the bytes via a pointer (and retrieve the length as well).
+// The bytes are not zero terminated if `b` is a view (use `kk_bytes_cbuf_borrow` for a C string).
 static inline const uint8_t* kk_bytes_buf_borrow(const kk_bytes_t b, kk_ssize_t* len) {
   static const uint8_t empty[16] = { 0 };
   if (kk_datatype_is_singleton(b)) {
@@ -146,15 +216,32 @@ static inline const uint8_t* kk_bytes_buf_borrow(const kk_bytes_t b, kk_ssize_t*
     if (len != NULL) *len = bn->length;
     return &bn->buf[0];
   }
-  else {
+  else if (tag == KK_TAG_BYTES_RAW) {
     kk_bytes_raw_t br = kk_datatype_as_assert(kk_bytes_raw_t, b, KK_TAG_BYTES_RAW);
     if (len != NULL) *len = br->length;
     return br->cbuf;
   }
+  else if (tag == KK_TAG_BYTES_VIEW) {
+    kk_bytes_view_t bv = kk_datatype_as_assert(kk_bytes_view_t, b, KK_TAG_BYTES_VIEW);
+    if (len != NULL) *len = bv->length;
+    return bv->cbuf;
+  }
+  else {
+    return kk_bytes_rope_buf_borrow(b, len);  // flattens the rope
+  }
 }
 
+// Call `fun` on each contiguous chunk of the bytes in order (without flattening ropes).
+// Stops early and returns `false` if `fun` returns `false`.
+typedef bool (kk_bytes_chunk_fun_t)(const uint8_t* buf, kk_ssize_t len, void* arg);
+kk_decl_export bool kk_bytes_foreach_chunk_borrow(const kk_bytes_t b, kk_bytes_chunk_fun_t* fun, void* arg);
+
+// Get access to the bytes as a zero terminated C string (and retrieve the length as well)
 static inline const char* kk_bytes_cbuf_borrow(const kk_bytes_t b, kk_ssize_t* len) {
-  return (const char*)kk_bytes_buf_borrow(b, len);
+  if (kk_unlikely(kk_datatype_has_tag(b, KK_TAG_BYTES_VIEW) || kk_datatype_has_tag(b, KK_TAG_BYTES_RAW))) {
+    return (const char*)kk_bytes_copy_cbuf_borrow(b, len);  // not zero terminated in general
+  }
+  return (const char*)kk_bytes_buf_borrow(b, len);  // (flattens ropes)
 }
 
 
@@ -164,6 +251,9 @@ static inline const char* kk_bytes_cbuf_borrow(const kk_bytes_t b, kk_ssize_t* l
 --------------------------------------------------------------------------------------------------*/
 
 static inline kk_ssize_t kk_decl_pure kk_bytes_len_borrow(const kk_bytes_t b) {
+  if (kk_datatype_has_tag(b, KK_TAG_BYTES_ROPE)) {  // don't flatten
+    return kk_datatype_as_assert(kk_bytes_rope_t, b, KK_TAG_BYTES_ROPE)->length;
+  }
   kk_ssize_t len;
   kk_bytes_buf_borrow(b, &len);
   return len;
@@ -179,8 +269,14 @@ static inline bool kk_bytes_is_empty(kk_bytes_t s, kk_context_t* ctx) {
   return (kk_bytes_len(s, ctx) == 0);
 }
 
+// Can the bytes of `b` be updated in-place? (unique and not pointing into a buffer it does not own)
+static inline bool kk_bytes_is_unique_owned(kk_bytes_t b) {
+  return (kk_datatype_is_unique(b) && !kk_datatype_has_tag(b, KK_TAG_BYTES_VIEW) && !kk_datatype_has_tag(b, KK_TAG_BYTES_RAW));
+}
+
+// Return bytes that can be updated in-place
 static inline kk_bytes_t kk_bytes_copy(kk_bytes_t b, kk_context_t* ctx) {
-  if (kk_datatype_is_singleton(b) || kk_datatype_is_unique(b)) {
+  if (kk_datatype_is_singleton(b) || kk_bytes_is_unique_owned(b)) {
     return b;
   }
   else {
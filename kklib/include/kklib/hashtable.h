@@ -0,0 +1,39 @@
+#pragma once
+#ifndef KK_HASHTABLE_H
+#define KK_HASHTABLE_H
+/*---------------------------------------------------------------------------
+  Copyright 2021, Microsoft Research, Daan Leijen.
+
+  This is free software; you can redistribute it and/or modify it under the
+  terms of the Apache License, Version 2.0. A copy of the License can be
+  found in the LICENSE file at the root of this distribution.
+---------------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------------------------
+  Mutable open-addressing hash tables with boxed keys and values.
+  The table is boxed as a raw C pointer and always mutated in-place; it is only
+  safe to use from a single thread (`std/data/hashtable` scopes it with `local`).
+  The `hash` function (`k -> int32`) and `eq` function (`(k,k) -> bool`) are
+  Koka closures that are called from C. The table itself is always borrowed,
+  while keys and values are owned. Slots are indices in `[0,capacity)`.
+--------------------------------------------------------------------------------------*/
+
+typedef kk_box_t kk_hashtable_t;
+
+kk_decl_export kk_hashtable_t kk_hashtable_alloc(kk_function_t hash, kk_function_t eq, kk_context_t* ctx);
+kk_decl_export kk_ssize_t kk_hashtable_count(kk_hashtable_t t, kk_context_t* ctx);
+kk_decl_export kk_ssize_t kk_hashtable_generation(kk_hashtable_t t, kk_context_t* ctx);   // changes when slots are moved or freed
+
+kk_decl_export kk_ssize_t kk_hashtable_find(kk_hashtable_t t, kk_box_t key, kk_context_t* ctx);                      // -1 if not found
+kk_decl_export kk_ssize_t kk_hashtable_find_or_insert(kk_hashtable_t t, kk_box_t key, kk_box_t init, kk_context_t* ctx); // inserts `init` if not found
+kk_decl_export kk_unit_t  kk_hashtable_insert(kk_hashtable_t t, kk_box_t key, kk_box_t value, kk_context_t* ctx);    // replaces an existing value
+kk_decl_export bool       kk_hashtable_remove(kk_hashtable_t t, kk_box_t key, kk_context_t* ctx);
+kk_decl_export kk_unit_t  kk_hashtable_clear(kk_hashtable_t t, kk_context_t* ctx);
+
+kk_decl_export kk_ssize_t kk_hashtable_next(kk_hashtable_t t, kk_ssize_t slot, kk_context_t* ctx);  // first used slot `>= slot`, or -1
+kk_decl_export kk_box_t   kk_hashtable_slot_key(kk_hashtable_t t, kk_ssize_t slot, kk_context_t* ctx);
+kk_decl_export kk_box_t   kk_hashtable_slot_value(kk_hashtable_t t, kk_ssize_t slot, kk_context_t* ctx);
+kk_decl_export kk_unit_t  kk_hashtable_slot_set(kk_hashtable_t t, kk_ssize_t slot, kk_box_t value, kk_context_t* ctx);
+kk_decl_export kk_box_t   kk_hashtable_slot_swap(kk_hashtable_t t, kk_ssize_t slot, kk_box_t value, kk_context_t* ctx);  // returns the previous value
+
+#endif // include guard
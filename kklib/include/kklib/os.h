@@ -25,15 +25,35 @@ kk_decl_export kk_vector_t kk_os_get_env(kk_context_t* ctx);
 kk_decl_export int  kk_os_read_text_file(kk_string_t path, kk_string_t* result, kk_context_t* ctx);
 kk_decl_export int  kk_os_write_text_file(kk_string_t path, kk_string_t content, kk_context_t* ctx);
 
+kk_decl_export int  kk_os_file_open(kk_string_t path, bool write, bool append, kk_ssize_t bufsize, kk_box_t* file, kk_context_t* ctx);
+kk_decl_export int  kk_os_file_read_chunk(kk_box_t file, kk_string_t* chunk, kk_context_t* ctx);
+kk_decl_export int  kk_os_file_read_line(kk_box_t file, kk_string_t* line, bool* eof, kk_context_t* ctx);
+kk_decl_export int  kk_os_file_write(kk_box_t file, kk_string_t s, kk_context_t* ctx);
+kk_decl_export int  kk_os_file_flush(kk_box_t file, kk_context_t* ctx);
+kk_decl_export int  kk_os_file_close(kk_box_t file, kk_context_t* ctx);
+
 kk_decl_export int  kk_os_ensure_dir(kk_string_t dir, int mode, kk_context_t* ctx);
 kk_decl_export int  kk_os_copy_file(kk_string_t from, kk_string_t to, bool preserve_mtime, kk_context_t* ctx);
 kk_decl_export bool kk_os_is_directory(kk_string_t path, kk_context_t* ctx);
 kk_decl_export bool kk_os_is_file(kk_string_t path, kk_context_t* ctx);
 kk_decl_export int  kk_os_list_directory(kk_string_t dir, kk_vector_t* contents, kk_context_t* ctx);
+kk_decl_export int  kk_os_walk_open(kk_string_t dir, int max_depth, kk_box_t* walker, kk_context_t* ctx);
+kk_decl_export int  kk_os_walk_next(kk_box_t walker, kk_vector_t* paths, kk_string_t* kinds, kk_context_t* ctx);
 
 kk_decl_export int  kk_os_run_command(kk_string_t cmd, kk_string_t* output, kk_context_t* ctx);
 kk_decl_export int  kk_os_run_system(kk_string_t cmd, kk_context_t* ctx);
 
+#define KK_OS_PROCESS_DONE    (0)
+#define KK_OS_PROCESS_STDOUT  (1)
+#define KK_OS_PROCESS_STDERR  (2)
+#define KK_OS_PROCESS_STDIN   (3)
+
+kk_decl_export int  kk_os_process_spawn(kk_string_t cmd, bool pipe_stdin, bool pipe_stderr, kk_box_t* proc, kk_context_t* ctx);
+kk_decl_export int  kk_os_process_next(kk_box_t proc, int* event, kk_context_t* ctx);
+kk_decl_export kk_string_t kk_os_process_chunk(kk_box_t proc, kk_context_t* ctx);
+kk_decl_export int  kk_os_process_write(kk_box_t proc, kk_string_t s, kk_context_t* ctx);
+kk_decl_export int  kk_os_process_wait(kk_box_t proc, int* exitcode, kk_context_t* ctx);
+
 kk_decl_export double kk_timer_ticks(double* secs_frac, kk_context_t* ctx);
 kk_decl_export double kk_timer_resolution(kk_context_t* ctx);
 
@@ -0,0 +1,46 @@
+#pragma once
+#ifndef KK_SIMD_H
+#define KK_SIMD_H
+/*---------------------------------------------------------------------------
+  Copyright 2021, Microsoft Research, Daan Leijen.
+
+  This is free software; you can redistribute it and/or modify it under the
+  terms of the Apache License, Version 2.0. A copy of the License can be
+  found in the LICENSE file at the root of this distribution.
+---------------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------------------------
+  Bulk kernels on unboxed arrays of doubles (see `kk_array_t`).
+  Element-wise operations use the length of the shortest argument and reuse the
+  first argument in-place if it is unique. Reductions give the same result for 
+  the scalar and vectorized kernels.
+--------------------------------------------------------------------------------------*/
+
+typedef enum kk_array_cmp_e {
+  KK_ARRAY_LT, KK_ARRAY_LE, KK_ARRAY_GT, KK_ARRAY_GE, KK_ARRAY_EQ, KK_ARRAY_NE
+} kk_array_cmp_t;
+
+kk_decl_export kk_box_t  kk_array_double_add(kk_box_t a, kk_box_t b, kk_context_t* ctx);
+kk_decl_export kk_box_t  kk_array_double_sub(kk_box_t a, kk_box_t b, kk_context_t* ctx);
+kk_decl_export kk_box_t  kk_array_double_mul(kk_box_t a, kk_box_t b, kk_context_t* ctx);
+kk_decl_export kk_box_t  kk_array_double_fma(kk_box_t a, kk_box_t b, kk_box_t c, kk_context_t* ctx);    // a*b + c (rounded once)
+kk_decl_export kk_box_t  kk_array_double_scale(kk_box_t a, double x, double y, kk_context_t* ctx);      // a*x + y (rounded once)
+
+kk_decl_export double    kk_array_double_sum(kk_box_t a, kk_context_t* ctx);
+kk_decl_export double    kk_array_double_dot(kk_box_t a, kk_box_t b, kk_context_t* ctx);
+kk_decl_export double    kk_array_double_min(kk_box_t a, kk_context_t* ctx);   // NaN for an empty array
+kk_decl_export double    kk_array_double_max(kk_box_t a, kk_context_t* ctx);   // NaN for an empty array
+kk_decl_export kk_box_t  kk_array_double_prefix_sum(kk_box_t a, kk_context_t* ctx);
+
+// Compare each element with `x` and return a byte array with 1 where the comparison holds (and 0 otherwise).
+kk_decl_export kk_box_t  kk_array_double_cmp(kk_box_t a, int32_t cmp, double x, kk_context_t* ctx);
+
+// `r[i] = a[idx[i]]` for an `int32` index array. Returns `ERANGE` if an index is out of bounds.
+kk_decl_export int       kk_array_double_gather(kk_box_t a, kk_box_t idx, kk_box_t* result, kk_context_t* ctx);
+// `a[idx[i]] = v[i]` (in-place if `a` is unique).
+kk_decl_export int       kk_array_double_scatter(kk_box_t a, kk_box_t idx, kk_box_t v, kk_box_t* result, kk_context_t* ctx);
+
+// The instruction set used by the kernels: "avx512", "avx2", "neon", or "scalar".
+kk_decl_export const char* kk_array_simd_name(void);
+
+#endif // include guard
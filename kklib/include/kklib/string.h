@@ -233,7 +233,18 @@ static inline const uint8_t* kk_string_buf_borrow(const kk_string_t str, kk_ssiz
 }
 
 static inline const char* kk_string_cbuf_borrow(const kk_string_t str, kk_ssize_t* len) {
-  return (const char*)kk_string_buf_borrow(str, len);
+  return kk_bytes_cbuf_borrow(str.bytes, len);
+}
+
+// Return the substring of `len` bytes starting at byte `start` as a view on `str` (see `kk_bytes_view`).
+// The start and end must be at utf-8 character boundaries.
+static inline kk_string_t kk_string_view(kk_string_t str, kk_ssize_t start, kk_ssize_t len, kk_context_t* ctx) {
+  return kk_unsafe_bytes_as_string_unchecked(kk_bytes_view(str.bytes, start, len, ctx));
+}
+
+// Traverse the utf-8 bytes of a string in chunks without flattening (see `kk_bytes_foreach_chunk_borrow`).
+static inline bool kk_string_foreach_chunk_borrow(const kk_string_t str, kk_bytes_chunk_fun_t* fun, void* arg) {
+  return kk_bytes_foreach_chunk_borrow(str.bytes, fun, arg);
 }
 
 static inline int kk_string_cmp_cstr_borrow(const kk_string_t s, const char* t) {
@@ -445,6 +456,15 @@ kk_decl_export kk_ssize_t kk_decl_pure kk_string_count_pattern_borrow(kk_string_
 kk_decl_export int kk_string_icmp_borrow(kk_string_t str1, kk_string_t str2);             // ascii case insensitive
 kk_decl_export int kk_string_icmp(kk_string_t str1, kk_string_t str2, kk_context_t* ctx);    // ascii case insensitive
 
+// Fast non-cryptographic hash of the bytes of a string (the result may change between versions).
+kk_decl_export uint64_t kk_decl_pure kk_string_hash_borrow(kk_string_t str);
+kk_decl_export int32_t kk_string_hash32(kk_string_t str, kk_context_t* ctx);
+
+
+// Return the canonical (interned) string with the same contents as `str`. Interned strings are 
+// never freed (using a sticky reference count) and equal interned strings are pointer-equal 
+// (which `kk_string_cmp_borrow` tests first). The table of interned strings is shared by all threads.
+kk_decl_export kk_string_t kk_string_intern(kk_string_t str, kk_context_t* ctx);
 
 kk_decl_export kk_string_t kk_string_from_char(kk_char_t c, kk_context_t* ctx);
 kk_decl_export kk_string_t kk_string_from_chars(kk_vector_t v, kk_context_t* ctx);
@@ -472,4 +492,36 @@ kk_decl_export kk_string_t kk_double_show_exp(double d, int32_t prec, kk_context
 kk_decl_export kk_string_t kk_double_show(double d, int32_t prec, kk_context_t* ctx);
 
 
+/*--------------------------------------------------------------------------------------------------
+  String builders (see `kk_bytes_builder_reserve`)
+  `kk_string_builder_build` returns the buffer of a unique builder as the final string without copying.
+  The append functions take ownership of the builder and are in-place if it is unique.
+--------------------------------------------------------------------------------------------------*/
+
+typedef kk_bytes_builder_t kk_string_builder_t;
+
+static inline kk_string_builder_t kk_string_builder_empty(void) {
+  return kk_bytes_builder_empty();
+}
+
+static inline kk_string_builder_t kk_string_builder_reserve(kk_string_builder_t sb, kk_ssize_t extra, uint8_t** p, kk_context_t* ctx) {
+  return kk_bytes_builder_reserve(sb, extra, p, ctx);
+}
+
+static inline kk_string_builder_t kk_string_builder_advance(kk_string_builder_t sb, kk_ssize_t n) {
+  return kk_bytes_builder_advance(sb, n);
+}
+
+static inline kk_string_t kk_string_builder_build(kk_string_builder_t sb, kk_context_t* ctx) {
+  return kk_unsafe_bytes_as_string_unchecked(kk_bytes_builder_build(sb, ctx));
+}
+
+kk_decl_export kk_string_builder_t kk_string_builder_append(kk_string_builder_t sb, kk_string_t s, kk_context_t* ctx);
+kk_decl_export kk_string_builder_t kk_string_builder_append_char(kk_string_builder_t sb, kk_char_t c, kk_context_t* ctx);
+kk_decl_export kk_string_builder_t kk_string_builder_append_integer(kk_string_builder_t sb, kk_integer_t x, kk_context_t* ctx);
+kk_decl_export kk_string_builder_t kk_string_builder_append_double_fixed(kk_string_builder_t sb, double d, int32_t prec, kk_context_t* ctx);
+kk_decl_export kk_string_builder_t kk_string_builder_append_double_exp(kk_string_builder_t sb, double d, int32_t prec, kk_context_t* ctx);
+kk_decl_export kk_string_builder_t kk_string_builder_append_double(kk_string_builder_t sb, double d, int32_t prec, kk_context_t* ctx);
+
+
 #endif // include guard
@@ -10,6 +10,7 @@
 
 #include <kklib.h>
 
+#include "async.c"
 #include "bits.c"
 #include "box.c"
 #include "bytes.c"
@@ -20,6 +21,8 @@
 #include "random.c"
 #include "ref.c"
 #include "refcount.c"
+#include "simd.c"
+#include "hashtable.c"
 #include "string.c"
 #include "thread.c"
 #include "time.c"
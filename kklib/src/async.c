@@ -0,0 +1,1060 @@
+/*---------------------------------------------------------------------------
+  Copyright 2021, Microsoft Research, Daan Leijen.
+
+  This is free software; you can redistribute it and/or modify it under the
+  terms of the Apache License, Version 2.0. A copy of the License can be
+  found in the LICENSE file at the root of this distribution.
+---------------------------------------------------------------------------*/
+#include "kklib.h"
+
+#if defined(WIN32)
+#include <windows.h>
+#include <sys/types.h>
+#include <fcntl.h>
+#include <io.h>
+#else
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <pthread.h>
+#endif
+
+#if defined(__linux__)
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#define KK_ASYNC_EPOLL  1
+#endif
+
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>) && __has_include(<sys/syscall.h>)
+#include <linux/io_uring.h>
+#include <sys/syscall.h>
+#include <sys/mman.h>
+#if defined(__NR_io_uring_setup) && defined(__NR_io_uring_enter)
+#define KK_ASYNC_URING  1
+#endif
+#endif
+#endif
+
+/*--------------------------------------------------------------------------------------------------
+  Event loop
+  Each thread has its own event loop (`kk_async_t`, stored in the context) with
+  - file operations that are submitted to `io_uring` or a worker pool,
+  - a heap of timers (`kk_async_set_timeout`),
+  - file descriptors watched for readiness through `epoll` (`kk_async_watch_fd`),
+  - a run queue of callbacks that are ready to run (`kk_async_post`).
+  Callbacks usually resume a continuation that was suspended by an `await` in `std/async`.
+  On Linux all sources are multiplexed through a single `epoll` descriptor: the
+  `io_uring` descriptor becomes readable when completions are available, and the
+  worker pool signals an `eventfd`.
+
+  An operation (`kk_async_op_t`) is split into requests (`kk_async_req_t`) of at most `chunk`
+  bytes that all transfer directly into (or from) the buffer of the operation. At most
+  `KK_ASYNC_DEPTH` requests are in flight at any time; the rest wait in the backlog.
+  Once all requests of an operation are reaped, its callback is invoked.
+--------------------------------------------------------------------------------------------------*/
+
+#define KK_ASYNC_DEPTH      (64)                    // maximal requests in flight
+#define KK_ASYNC_WORKERS    (4)                     // worker threads when `io_uring` is not available
+#define KK_ASYNC_CHUNK_MIN  (4*1024)
+#define KK_ASYNC_CHUNK_MAX  (256*1024*1024)          // fits in the 32-bit length of an `io_uring` request
+
+typedef struct kk_async_file_s {
+  int         fd;
+  kk_ssize_t  pending;     // outstanding operations
+  bool        closing;     // close once `pending` drops to zero
+} kk_async_file_t;
+
+typedef struct kk_async_op_s {
+  kk_function_t callback;
+  kk_box_t      file;      // keeps the file alive while the operation is outstanding
+  kk_bytes_t    data;
+  uint8_t*      buf;
+  bool          is_write;
+  kk_ssize_t    len;       // requested length
+  kk_ssize_t    count;     // transferred bytes (shrinks to the end of the file for reads)
+  kk_ssize_t    pending;   // outstanding requests
+  int           err;
+} kk_async_op_t;
+
+typedef struct kk_async_req_s {
+  struct kk_async_req_s* next;
+  kk_async_op_t* op;
+  int            fd;
+  int64_t        offset;   // file offset
+  kk_ssize_t     start;    // offset in the buffer of `op`
+  kk_ssize_t     len;
+  kk_ssize_t     result;   // bytes transferred, or `-errno`
+} kk_async_req_t;
+
+static void kk_async_req_perform(kk_async_req_t* req) {
+  uint8_t* p = req->op->buf + req->start;
+#if defined(WIN32)
+  int n = -1;
+  if (_lseeki64(req->fd, req->offset, SEEK_SET) >= 0) {
+    n = (req->op->is_write ? _write(req->fd, p, (unsigned)req->len) : _read(req->fd, p, (unsigned)req->len));
+  }
+#else
+  ssize_t n;
+  do {
+    n = (req->op->is_write ? pwrite(req->fd, p, (size_t)req->len, (off_t)req->offset)
+                           : pread(req->fd, p, (size_t)req->len, (off_t)req->offset));
+  } while (n < 0 && errno == EINTR);
+#endif
+  req->result = (n < 0 ? -(kk_ssize_t)errno : (kk_ssize_t)n);
+}
+
+
+/*--------------------------------------------------------------------------------------------------
+  io_uring backend
+  We use the raw system calls to avoid a dependency on liburing. Submissions are
+  batched and passed to the kernel together with the wait for completions.
+--------------------------------------------------------------------------------------------------*/
+#if KK_ASYNC_URING
+
+typedef struct kk_async_uring_s {
+  int       fd;
+  unsigned  unsubmitted;   // entries written to the submission queue but not yet entered
+  unsigned* sq_tail;
+  unsigned* sq_mask;
+  unsigned* sq_array;
+  struct io_uring_sqe* sqes;
+  unsigned* cq_head;
+  unsigned* cq_tail;
+  unsigned* cq_mask;
+  struct io_uring_cqe* cqes;
+  void*     sq_ring;
+  size_t    sq_ring_size;
+  void*     cq_ring;
+  size_t    cq_ring_size;
+  size_t    sqes_size;
+} kk_async_uring_t;
+
+static void kk_async_uring_free(kk_async_uring_t* ring) {
+  if (ring->sqes != NULL) munmap(ring->sqes, ring->sqes_size);
+  if (ring->cq_ring != NULL && ring->cq_ring != ring->sq_ring) munmap(ring->cq_ring, ring->cq_ring_size);
+  if (ring->sq_ring != NULL) munmap(ring->sq_ring, ring->sq_ring_size);
+  close(ring->fd);
+  kk_free(ring);
+}
+
+static kk_async_uring_t* kk_async_uring_alloc(kk_context_t* ctx) {
+  struct io_uring_params p;
+  memset(&p, 0, sizeof(p));
+  int fd = (int)syscall(__NR_io_uring_setup, KK_ASYNC_DEPTH, &p);
+  if (fd < 0) return NULL;   // not supported, or disabled
+  kk_async_uring_t* ring = (kk_async_uring_t*)kk_zalloc(kk_ssizeof(kk_async_uring_t), ctx);
+  if (ring == NULL) { close(fd); return NULL; }
+  ring->fd = fd;
+  ring->sq_ring_size = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+  ring->cq_ring_size = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+  const bool single = ((p.features & IORING_FEAT_SINGLE_MMAP) != 0);
+  if (single) {
+    if (ring->cq_ring_size > ring->sq_ring_size) ring->sq_ring_size = ring->cq_ring_size;
+    ring->cq_ring_size = ring->sq_ring_size;
+  }
+  void* sq = mmap(NULL, ring->sq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+  if (sq == MAP_FAILED) { kk_async_uring_free(ring); return NULL; }
+  ring->sq_ring = sq;
+  void* cq = sq;
+  if (!single) {
+    cq = mmap(NULL, ring->cq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+    if (cq == MAP_FAILED) { kk_async_uring_free(ring); return NULL; }
+  }
+  ring->cq_ring = cq;
+  ring->sqes_size = p.sq_entries * sizeof(struct io_uring_sqe);
+  void* sqes = mmap(NULL, ring->sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+  if (sqes == MAP_FAILED) { kk_async_uring_free(ring); return NULL; }
+  ring->sqes     = (struct io_uring_sqe*)sqes;
+  ring->sq_tail  = (unsigned*)((uint8_t*)sq + p.sq_off.tail);
+  ring->sq_mask  = (unsigned*)((uint8_t*)sq + p.sq_off.ring_mask);
+  ring->sq_array = (unsigned*)((uint8_t*)sq + p.sq_off.array);
+  ring->cq_head  = (unsigned*)((uint8_t*)cq + p.cq_off.head);
+  ring->cq_tail  = (unsigned*)((uint8_t*)cq + p.cq_off.tail);
+  ring->cq_mask  = (unsigned*)((uint8_t*)cq + p.cq_off.ring_mask);
+  ring->cqes     = (struct io_uring_cqe*)((uint8_t*)cq + p.cq_off.cqes);
+  return ring;
+}
+
+// The submission queue has at least `KK_ASYNC_DEPTH` entries and we never have more requests in flight.
+static void kk_async_uring_submit(kk_async_uring_t* ring, kk_async_req_t* req) {
+  const unsigned tail = *ring->sq_tail;   // we are the only producer
+  const unsigned idx  = tail & *ring->sq_mask;
+  struct io_uring_sqe* sqe = &ring->sqes[idx];
+  memset(sqe, 0, sizeof(*sqe));
+  sqe->opcode = (req->op->is_write ? IORING_OP_WRITE : IORING_OP_READ);
+  sqe->fd = req->fd;
+  sqe->off = (uint64_t)req->offset;
+  sqe->addr = (uint64_t)(uintptr_t)(req->op->buf + req->start);
+  sqe->len = (uint32_t)req->len;
+  sqe->user_data = (uint64_t)(uintptr_t)req;
+  ring->sq_array[idx] = idx;
+  __atomic_store_n(ring->sq_tail, tail + 1, __ATOMIC_RELEASE);
+  ring->unsubmitted++;
+}
+
+// Enter pending submissions (without waiting).
+static int kk_async_uring_enter(kk_async_uring_t* ring) {
+  while (ring->unsubmitted > 0) {
+    const int n = (int)syscall(__NR_io_uring_enter, ring->fd, ring->unsubmitted, 0, 0, NULL, 0);
+    if (n < 0) {
+      if (errno == EINTR) continue;
+      if (errno == EAGAIN || errno == EBUSY) return 0;   // retried on the next poll
+      return errno;
+    }
+    ring->unsubmitted -= (unsigned)n;
+  }
+  return 0;
+}
+
+// Enter pending submissions and return the list of completed requests (in completion order).
+static int kk_async_uring_reap(kk_async_uring_t* ring, kk_async_req_t** done) {
+  *done = NULL;
+  kk_async_req_t** last = done;
+  const int err = kk_async_uring_enter(ring);
+  unsigned head = *ring->cq_head;
+  const unsigned tail = __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE);
+  for (; head != tail; head++) {
+    struct io_uring_cqe* cqe = &ring->cqes[head & *ring->cq_mask];
+    kk_async_req_t* req = (kk_async_req_t*)(uintptr_t)cqe->user_data;
+    req->result = cqe->res;
+    req->next = NULL;
+    *last = req;
+    last = &req->next;
+  }
+  __atomic_store_n(ring->cq_head, head, __ATOMIC_RELEASE);
+  return err;
+}
+
+#endif
+
+
+/*--------------------------------------------------------------------------------------------------
+  Thread pool backend
+--------------------------------------------------------------------------------------------------*/
+#if !defined(WIN32)
+
+typedef struct kk_async_pool_s {
+  pthread_mutex_t  lock;
+  pthread_cond_t   has_work;
+  pthread_cond_t   has_done;
+  kk_async_req_t*  work;        // FIFO
+  kk_async_req_t*  work_tail;
+  kk_async_req_t*  done;        // LIFO
+  bool             stop;
+  int              notify;      // `eventfd` that is signaled on completions (or -1)
+  kk_ssize_t       thread_count;
+  pthread_t        threads[KK_ASYNC_WORKERS];
+} kk_async_pool_t;
+
+static void* kk_async_pool_worker(void* vpool) {
+  kk_async_pool_t* pool = (kk_async_pool_t*)vpool;
+  pthread_mutex_lock(&pool->lock);
+  while (true) {
+    while (!pool->stop && pool->work == NULL) {
+      pthread_cond_wait(&pool->has_work, &pool->lock);
+    }
+    if (pool->stop) break;
+    kk_async_req_t* req = pool->work;
+    pool->work = req->next;
+    if (pool->work == NULL) pool->work_tail = NULL;
+    pthread_mutex_unlock(&pool->lock);
+    kk_async_req_perform(req);
+    pthread_mutex_lock(&pool->lock);
+    req->next = pool->done;
+    pool->done = req;
+    pthread_cond_signal(&pool->has_done);
+#if KK_ASYNC_EPOLL
+    if (pool->notify >= 0) {
+      const uint64_t one = 1;
+      ssize_t n = write(pool->notify, &one, sizeof(one));
+      KK_UNUSED(n);  // only fails if the counter overflows, in which case it is signaled anyway
+    }
+#endif
+  }
+  pthread_mutex_unlock(&pool->lock);
+  return NULL;
+}
+
+static void kk_async_pool_free(kk_async_pool_t* pool) {
+  pthread_mutex_lock(&pool->lock);
+  pool->stop = true;
+  pthread_cond_broadcast(&pool->has_work);
+  pthread_mutex_unlock(&pool->lock);
+  for (kk_ssize_t i = 0; i < pool->thread_count; i++) {
+    pthread_join(pool->threads[i], NULL);
+  }
+  pthread_cond_destroy(&pool->has_done);
+  pthread_cond_destroy(&pool->has_work);
+  pthread_mutex_destroy(&pool->lock);
+  if (pool->notify >= 0) close(pool->notify);
+  kk_free(pool);
+}
+
+static kk_async_pool_t* kk_async_pool_alloc(kk_context_t* ctx) {
+  kk_async_pool_t* pool = (kk_async_pool_t*)kk_zalloc(kk_ssizeof(kk_async_pool_t), ctx);
+  if (pool == NULL) return NULL;
+  pthread_mutex_init(&pool->lock, NULL);
+  pthread_cond_init(&pool->has_work, NULL);
+  pthread_cond_init(&pool->has_done, NULL);
+#if KK_ASYNC_EPOLL
+  pool->notify = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+#else
+  pool->notify = -1;
+#endif
+  for (kk_ssize_t i = 0; i < KK_ASYNC_WORKERS; i++) {
+    if (pthread_create(&pool->threads[i], NULL, &kk_async_pool_worker, pool) != 0) break;
+    pool->thread_count++;
+  }
+  if (pool->thread_count == 0) {
+    kk_async_pool_free(pool);
+    return NULL;
+  }
+  return pool;
+}
+
+static void kk_async_pool_submit(kk_async_pool_t* pool, kk_async_req_t* req) {
+  req->next = NULL;
+  pthread_mutex_lock(&pool->lock);
+  if (pool->work_tail == NULL) pool->work = req;
+                          else pool->work_tail->next = req;
+  pool->work_tail = req;
+  pthread_cond_signal(&pool->has_work);
+  pthread_mutex_unlock(&pool->lock);
+}
+
+// Wait until a request completes, or at most `timeout` nano seconds (if not negative).
+static void kk_async_pool_wait(kk_async_pool_t* pool, int64_t timeout) {
+  pthread_mutex_lock(&pool->lock);
+  if (timeout < 0) {
+    while (pool->done == NULL) pthread_cond_wait(&pool->has_done, &pool->lock);
+  }
+  else if (pool->done == NULL) {
+    struct timespec due;
+    clock_gettime(CLOCK_REALTIME, &due);
+    due.tv_sec  += (time_t)(timeout / 1000000000);
+    due.tv_nsec += (long)(timeout % 1000000000);
+    if (due.tv_nsec >= 1000000000) { due.tv_sec++; due.tv_nsec -= 1000000000; }
+    while (pool->done == NULL) {
+      if (pthread_cond_timedwait(&pool->has_done, &pool->lock, &due) == ETIMEDOUT) break;
+    }
+  }
+  pthread_mutex_unlock(&pool->lock);
+}
+
+static int kk_async_pool_reap(kk_async_pool_t* pool, kk_async_req_t** done) {
+  pthread_mutex_lock(&pool->lock);
+  kk_async_req_t* reqs = pool->done;
+  pool->done = NULL;
+  pthread_mutex_unlock(&pool->lock);
+  // reverse to completion order
+  *done = NULL;
+  while (reqs != NULL) {
+    kk_async_req_t* next = reqs->next;
+    reqs->next = *done;
+    *done = reqs;
+    reqs = next;
+  }
+  return 0;
+}
+
+#endif
+
+
+/*--------------------------------------------------------------------------------------------------
+  Per-thread event loop
+  If neither `io_uring` nor worker threads are available, requests are performed
+  synchronously on submission and reaped on the next poll.
+--------------------------------------------------------------------------------------------------*/
+
+typedef struct kk_async_timer_s {
+  int64_t       due;         // in nano seconds (monotonic)
+  int64_t       id;          // increasing such that timers with the same deadline fire in order
+  kk_function_t callback;
+} kk_async_timer_t;
+
+typedef struct kk_async_ready_s {
+  struct kk_async_ready_s* next;
+  kk_function_t callback;
+} kk_async_ready_t;
+
+typedef struct kk_async_watch_s {
+  int           fd;
+  kk_function_t callback;
+} kk_async_watch_t;
+
+typedef struct kk_async_s {
+  kk_ssize_t        ops;           // outstanding operations
+  kk_ssize_t        inflight;      // requests submitted to the backend
+  kk_async_req_t*   backlog;       // requests waiting for a free slot (FIFO)
+  kk_async_req_t*   backlog_tail;
+  kk_async_req_t*   done;          // requests completed synchronously (LIFO)
+  kk_async_timer_t* timers;        // binary min-heap on (`due`,`id`)
+  kk_ssize_t        timer_count;
+  kk_ssize_t        timer_cap;
+  int64_t           timer_next_id;
+  kk_async_ready_t* ready;         // run queue (FIFO)
+  kk_async_ready_t* ready_tail;
+  kk_ssize_t        ready_count;
+  kk_ssize_t        watches;       // watched file descriptors
+  kk_box_t          failure;       // first exception raised by a detached strand (or `kk_box_null`)
+#if KK_ASYNC_EPOLL
+  int               epfd;
+#endif
+#if KK_ASYNC_URING
+  kk_async_uring_t* uring;
+#endif
+#if !defined(WIN32)
+  kk_async_pool_t*  pool;
+#endif
+} kk_async_t;
+
+#define KK_ASYNC_EV_URING   (1)       // `epoll` data for the `io_uring` descriptor
+#define KK_ASYNC_EV_POOL    (2)       // `epoll` data for the worker pool `eventfd`
+
+static kk_async_t* kk_async_get(kk_context_t* ctx) {
+  kk_async_t* as = ctx->async;
+  if (kk_likely(as != NULL)) return as;
+  as = (kk_async_t*)kk_zalloc(kk_ssizeof(kk_async_t), ctx);
+  if (as == NULL) kk_fatal_error(ENOMEM, "unable to allocate the event loop");
+  as->failure = kk_box_null;
+#if KK_ASYNC_EPOLL
+  as->epfd = epoll_create1(EPOLL_CLOEXEC);
+#endif
+#if KK_ASYNC_URING
+  if (as->epfd >= 0) {
+    as->uring = kk_async_uring_alloc(ctx);
+    if (as->uring != NULL) {
+      struct epoll_event ev;
+      ev.events = EPOLLIN;
+      ev.data.u64 = KK_ASYNC_EV_URING;
+      if (epoll_ctl(as->epfd, EPOLL_CTL_ADD, as->uring->fd, &ev) != 0) {
+        kk_async_uring_free(as->uring);
+        as->uring = NULL;
+      }
+    }
+  }
+  if (as->uring == NULL)
+#endif
+  {
+#if !defined(WIN32)
+    as->pool = kk_async_pool_alloc(ctx);
+#if KK_ASYNC_EPOLL
+    if (as->pool != NULL && as->epfd >= 0 && as->pool->notify >= 0) {
+      struct epoll_event ev;
+      ev.events = EPOLLIN;
+      ev.data.u64 = KK_ASYNC_EV_POOL;
+      if (epoll_ctl(as->epfd, EPOLL_CTL_ADD, as->pool->notify, &ev) != 0) {
+        close(as->pool->notify);
+        as->pool->notify = -1;   // wait on the pool condition instead
+      }
+    }
+#endif
+#endif
+  }
+  ctx->async = as;
+  return as;
+}
+
+bool kk_async_uses_uring(kk_context_t* ctx) {
+#if KK_ASYNC_URING
+  return (kk_async_get(ctx)->uring != NULL);
+#else
+  KK_UNUSED(ctx);
+  return false;
+#endif
+}
+
+void kk_async_free(kk_context_t* ctx) {
+  kk_async_t* as = ctx->async;
+  if (as == NULL) return;
+#if KK_ASYNC_URING
+  if (as->uring != NULL) kk_async_uring_free(as->uring);
+#endif
+#if !defined(WIN32)
+  if (as->pool != NULL) kk_async_pool_free(as->pool);
+#endif
+#if KK_ASYNC_EPOLL
+  if (as->epfd >= 0) close(as->epfd);
+#endif
+  // pending callbacks are never invoked
+  for (kk_ssize_t i = 0; i < as->timer_count; i++) {
+    kk_function_drop(as->timers[i].callback, ctx);
+  }
+  kk_free(as->timers);
+  while (as->ready != NULL) {
+    kk_async_ready_t* r = as->ready;
+    as->ready = r->next;
+    kk_function_drop(r->callback, ctx);
+    kk_free(r);
+  }
+  kk_box_drop(as->failure, ctx);
+  ctx->async = NULL;
+  kk_free(as);
+}
+
+static kk_ssize_t kk_async_outstanding(kk_async_t* as) {
+  return (as->ops + as->timer_count + as->ready_count + as->watches);
+}
+
+static void kk_async_backend_submit(kk_async_t* as, kk_async_req_t* req) {
+  as->inflight++;
+#if KK_ASYNC_URING
+  if (as->uring != NULL) { kk_async_uring_submit(as->uring, req); return; }
+#endif
+#if !defined(WIN32)
+  if (as->pool != NULL) { kk_async_pool_submit(as->pool, req); return; }
+#endif
+  kk_async_req_perform(req);
+  req->next = as->done;
+  as->done = req;
+}
+
+// Return the requests that completed (without waiting).
+static int kk_async_backend_reap(kk_async_t* as, kk_async_req_t** done) {
+  if (as->done != NULL) {
+    *done = as->done;
+    as->done = NULL;
+    return 0;
+  }
+#if KK_ASYNC_URING
+  if (as->uring != NULL) return kk_async_uring_reap(as->uring, done);
+#endif
+#if !defined(WIN32)
+  if (as->pool != NULL) return kk_async_pool_reap(as->pool, done);
+#endif
+  *done = NULL;
+  return 0;
+}
+
+static void kk_async_enqueue(kk_async_t* as, kk_async_req_t* req) {
+  if (as->inflight < KK_ASYNC_DEPTH) {
+    kk_async_backend_submit(as, req);
+  }
+  else {
+    req->next = NULL;
+    if (as->backlog_tail == NULL) as->backlog = req;
+                             else as->backlog_tail->next = req;
+    as->backlog_tail = req;
+  }
+}
+
+static void kk_async_submit_backlog(kk_async_t* as) {
+  while (as->backlog != NULL && as->inflight < KK_ASYNC_DEPTH) {
+    kk_async_req_t* req = as->backlog;
+    as->backlog = req->next;
+    if (as->backlog == NULL) as->backlog_tail = NULL;
+    kk_async_backend_submit(as, req);
+  }
+}
+
+
+/*--------------------------------------------------------------------------------------------------
+  Operations
+--------------------------------------------------------------------------------------------------*/
+
+static void kk_async_file_release(kk_async_file_t* f) {
+  if (f->closing && f->pending == 0 && f->fd >= 0) {
+#if defined(WIN32)
+    _close(f->fd);
+#else
+    close(f->fd);
+#endif
+    f->fd = -1;
+  }
+}
+
+static void kk_async_file_free(void* p, kk_block_t* b, kk_context_t* ctx) {
+  KK_UNUSED(b); KK_UNUSED(ctx);
+  kk_async_file_t* f = (kk_async_file_t*)p;
+  if (f == NULL) return;
+  f->closing = true;
+  kk_async_file_release(f);
+  kk_free(f);
+}
+
+static kk_async_file_t* kk_async_file_unbox_borrow(kk_box_t file) {
+  return (kk_async_file_t*)kk_cptr_raw_unbox(file);
+}
+
+int kk_async_file_open(kk_string_t path, bool write, kk_box_t* file, kk_context_t* ctx) {
+  *file = kk_box_null;
+  int fd = -1;
+#if defined(WIN32)
+  const int flags = (write ? (_O_WRONLY | _O_CREAT | _O_TRUNC | _O_BINARY) : (_O_RDONLY | _O_BINARY));
+  kk_with_string_as_qutf16w_borrow(path, wpath, ctx) {
+    fd = _wopen(wpath, flags, _S_IREAD | _S_IWRITE);
+  }
+#else
+  const int flags = (write ? (O_WRONLY | O_CREAT | O_TRUNC) : O_RDONLY);
+  kk_with_string_as_qutf8_borrow(path, bpath, ctx) {
+    fd = open(bpath, flags, 0644);
+  }
+#endif
+  kk_string_drop(path, ctx);
+  if (fd < 0) return errno;
+  kk_async_file_t* f = (kk_async_file_t*)kk_malloc(kk_ssizeof(kk_async_file_t), ctx);
+  if (f == NULL) {
+#if defined(WIN32)
+    _close(fd);
+#else
+    close(fd);
+#endif
+    return ENOMEM;
+  }
+  f->fd = fd;
+  f->pending = 0;
+  f->closing = false;
+  *file = kk_cptr_raw_box(&kk_async_file_free, f, ctx);
+  return 0;
+}
+
+int kk_async_file_size(kk_box_t file, int64_t* size, kk_context_t* ctx) {
+  *size = 0;
+  kk_async_file_t* f = kk_async_file_unbox_borrow(file);
+  int err = 0;
+  if (f->fd < 0 || f->closing) {
+    err = EBADF;
+  }
+  else {
+#if defined(WIN32)
+    struct _stat64 st;
+    if (_fstat64(f->fd, &st) < 0) err = errno;
+#else
+    struct stat st;
+    if (fstat(f->fd, &st) < 0) err = errno;
+#endif
+    else *size = (int64_t)st.st_size;
+  }
+  kk_box_drop(file, ctx);
+  return err;
+}
+
+int kk_async_file_close(kk_box_t file, kk_context_t* ctx) {
+  kk_async_file_t* f = kk_async_file_unbox_borrow(file);
+  int err = 0;
+  if (f->fd < 0 || f->closing) {
+    err = EBADF;
+  }
+  else {
+    f->closing = true;
+    kk_async_file_release(f);
+  }
+  kk_box_drop(file, ctx);
+  return err;
+}
+
+static void kk_async_op_complete(kk_async_t* as, kk_async_op_t* op, kk_context_t* ctx) {
+  as->ops--;
+  kk_async_file_t* f = kk_async_file_unbox_borrow(op->file);
+  f->pending--;
+  kk_async_file_release(f);
+  kk_box_drop(op->file, ctx);
+  kk_string_t s = kk_string_empty();
+  if (!op->is_write && op->err == 0) {
+    s = kk_string_convert_from_qutf8(kk_bytes_adjust_length(op->data, op->count, ctx), ctx);
+  }
+  else {
+    kk_bytes_drop(op->data, ctx);
+  }
+  kk_function_t callback = op->callback;
+  const int32_t err = op->err;
+  const kk_ssize_t count = (err == 0 ? op->count : 0);
+  kk_free(op);
+  kk_function_call(kk_unit_t, (kk_function_t, int32_t, kk_ssize_t, kk_string_t, kk_context_t*), callback, (callback, err, count, s, ctx));
+}
+
+static void kk_async_req_complete(kk_async_t* as, kk_async_req_t* req, kk_context_t* ctx) {
+  kk_async_op_t* op = req->op;
+  if (req->result < 0) {
+    if (op->err == 0) op->err = (int)(-req->result);
+  }
+  else if (req->result == 0) {
+    // end of file
+    if (op->is_write) {
+      if (op->err == 0) op->err = EIO;
+    }
+    else if (req->start < op->count) {
+      op->count = req->start;
+    }
+  }
+  else if (req->result < req->len) {
+    // short transfer: continue with the rest
+    req->offset += req->result;
+    req->start  += req->result;
+    req->len    -= req->result;
+    kk_async_enqueue(as, req);
+    return;
+  }
+  kk_free(req);
+  op->pending--;
+  if (op->pending == 0) kk_async_op_complete(as, op, ctx);
+}
+
+static void kk_async_op_fail(kk_async_op_t* op, int err, kk_context_t* ctx) {
+  kk_function_t callback = op->callback;
+  kk_box_drop(op->file, ctx);
+  kk_bytes_drop(op->data, ctx);
+  kk_free(op);
+  kk_function_call(kk_unit_t, (kk_function_t, int32_t, kk_ssize_t, kk_string_t, kk_context_t*), callback, (callback, (int32_t)err, 0, kk_string_empty(), ctx));
+}
+
+static void kk_async_op_start(kk_async_op_t* op, int64_t offset, kk_ssize_t chunk, kk_context_t* ctx) {
+  kk_async_file_t* f = kk_async_file_unbox_borrow(op->file);
+  if (f->fd < 0 || f->closing) { kk_async_op_fail(op, EBADF, ctx); return; }
+  if (offset < 0 || op->len < 0) { kk_async_op_fail(op, EINVAL, ctx); return; }
+  if (op->len == 0) {
+    kk_function_t callback = op->callback;
+    kk_box_drop(op->file, ctx);
+    kk_bytes_drop(op->data, ctx);
+    kk_free(op);
+    kk_function_call(kk_unit_t, (kk_function_t, int32_t, kk_ssize_t, kk_string_t, kk_context_t*), callback, (callback, 0, 0, kk_string_empty(), ctx));
+    return;
+  }
+  if (chunk < KK_ASYNC_CHUNK_MIN) chunk = KK_ASYNC_CHUNK_MIN;
+  if (chunk > KK_ASYNC_CHUNK_MAX) chunk = KK_ASYNC_CHUNK_MAX;
+  kk_async_t* as = kk_async_get(ctx);
+  as->ops++;
+  f->pending++;
+  op->pending = (op->len + chunk - 1) / chunk;
+  for (kk_ssize_t start = 0; start < op->len; start += chunk) {
+    kk_async_req_t* req = (kk_async_req_t*)kk_malloc(kk_ssizeof(kk_async_req_t), ctx);
+    if (req == NULL) kk_fatal_error(ENOMEM, "unable to allocate an asynchronous I/O request");
+    req->next = NULL;
+    req->op = op;
+    req->fd = f->fd;
+    req->offset = offset + start;
+    req->start = start;
+    req->len = (op->len - start < chunk ? op->len - start : chunk);
+    req->result = 0;
+    kk_async_enqueue(as, req);
+  }
+}
+
+static kk_async_op_t* kk_async_op_alloc(kk_box_t file, bool is_write, kk_function_t callback, kk_context_t* ctx) {
+  kk_async_op_t* op = (kk_async_op_t*)kk_malloc(kk_ssizeof(kk_async_op_t), ctx);
+  if (op == NULL) kk_fatal_error(ENOMEM, "unable to allocate an asynchronous I/O operation");
+  op->callback = callback;
+  op->file = file;
+  op->data = kk_bytes_empty();
+  op->buf = NULL;
+  op->is_write = is_write;
+  op->len = 0;
+  op->count = 0;
+  op->pending = 0;
+  op->err = 0;
+  return op;
+}
+
+void kk_async_read(kk_box_t file, int64_t offset, kk_ssize_t len, kk_ssize_t chunk, kk_function_t callback, kk_context_t* ctx) {
+  kk_async_op_t* op = kk_async_op_alloc(file, false, callback, ctx);
+  if (len > 0) {
+    op->data = kk_bytes_alloc_buf(len, &op->buf, ctx);
+    op->len = op->count = len;
+  }
+  kk_async_op_start(op, offset, chunk, ctx);
+}
+
+void kk_async_write(kk_box_t file, int64_t offset, kk_string_t s, kk_ssize_t chunk, kk_function_t callback, kk_context_t* ctx) {
+  kk_async_op_t* op = kk_async_op_alloc(file, true, callback, ctx);
+  kk_ssize_t len;
+  const uint8_t* buf = kk_bytes_buf_borrow(s.bytes, &len);
+  op->data = s.bytes;           // keeps `buf` alive; only read by the backend
+  op->buf = (uint8_t*)buf;
+  op->len = op->count = len;
+  kk_async_op_start(op, offset, chunk, ctx);
+}
+
+/*--------------------------------------------------------------------------------------------------
+  Timers
+--------------------------------------------------------------------------------------------------*/
+
+static int64_t kk_async_now(kk_context_t* ctx) {
+  double frac;
+  const double secs = kk_timer_ticks(&frac, ctx);
+  return ((int64_t)secs * 1000000000) + (int64_t)(((secs - (double)((int64_t)secs)) + frac) * 1e9);
+}
+
+static bool kk_async_timer_before(const kk_async_timer_t* t1, const kk_async_timer_t* t2) {
+  return (t1->due < t2->due || (t1->due == t2->due && t1->id < t2->id));
+}
+
+static void kk_async_timer_sift_up(kk_async_t* as, kk_ssize_t i) {
+  kk_async_timer_t t = as->timers[i];
+  while (i > 0) {
+    const kk_ssize_t parent = (i - 1) / 2;
+    if (!kk_async_timer_before(&t, &as->timers[parent])) break;
+    as->timers[i] = as->timers[parent];
+    i = parent;
+  }
+  as->timers[i] = t;
+}
+
+static void kk_async_timer_sift_down(kk_async_t* as, kk_ssize_t i) {
+  kk_async_timer_t t = as->timers[i];
+  const kk_ssize_t n = as->timer_count;
+  while (true) {
+    kk_ssize_t child = 2*i + 1;
+    if (child >= n) break;
+    if (child + 1 < n && kk_async_timer_before(&as->timers[child + 1], &as->timers[child])) child++;
+    if (!kk_async_timer_before(&as->timers[child], &t)) break;
+    as->timers[i] = as->timers[child];
+    i = child;
+  }
+  as->timers[i] = t;
+}
+
+static kk_async_timer_t kk_async_timer_remove_at(kk_async_t* as, kk_ssize_t i) {
+  kk_async_timer_t t = as->timers[i];
+  as->timer_count--;
+  if (i < as->timer_count) {
+    as->timers[i] = as->timers[as->timer_count];
+    kk_async_timer_sift_down(as, i);
+    kk_async_timer_sift_up(as, i);
+  }
+  return t;
+}
+
+int64_t kk_async_set_timeout(int64_t ms, kk_function_t callback, kk_context_t* ctx) {
+  kk_async_t* as = kk_async_get(ctx);
+  if (as->timer_count >= as->timer_cap) {
+    const kk_ssize_t newcap = (as->timer_cap == 0 ? 16 : 2*as->timer_cap);
+    kk_async_timer_t* timers = (kk_async_timer_t*)kk_realloc(as->timers, newcap * kk_ssizeof(kk_async_timer_t), ctx);
+    if (timers == NULL) kk_fatal_error(ENOMEM, "unable to allocate a timer");
+    as->timers = timers;
+    as->timer_cap = newcap;
+  }
+  if (ms < 0) ms = 0;
+  kk_async_timer_t* t = &as->timers[as->timer_count];
+  t->due = kk_async_now(ctx) + (ms * 1000000);
+  t->id = ++as->timer_next_id;
+  t->callback = callback;
+  as->timer_count++;
+  kk_async_timer_sift_up(as, as->timer_count - 1);
+  return as->timer_next_id;
+}
+
+// Timers are rarely cleared so we search linearly.
+bool kk_async_clear_timeout(int64_t id, kk_context_t* ctx) {
+  kk_async_t* as = ctx->async;
+  if (as == NULL) return false;
+  for (kk_ssize_t i = 0; i < as->timer_count; i++) {
+    if (as->timers[i].id == id) {
+      kk_async_timer_t t = kk_async_timer_remove_at(as, i);
+      kk_function_drop(t.callback, ctx);
+      return true;
+    }
+  }
+  return false;
+}
+
+// Invoke the callbacks of expired timers; returns `true` if any expired.
+static bool kk_async_timers_run(kk_async_t* as, kk_context_t* ctx) {
+  if (as->timer_count == 0) return false;
+  const int64_t now = kk_async_now(ctx);
+  bool fired = false;
+  // timers added by the callbacks are due at least at `now` and run on the next poll
+  const int64_t last_id = as->timer_next_id;
+  while (as->timer_count > 0 && as->timers[0].due <= now && as->timers[0].id <= last_id) {
+    kk_async_timer_t t = kk_async_timer_remove_at(as, 0);
+    fired = true;
+    kk_function_call(kk_unit_t, (kk_function_t, kk_context_t*), t.callback, (t.callback, ctx));
+  }
+  return fired;
+}
+
+
+/*--------------------------------------------------------------------------------------------------
+  Run queue
+--------------------------------------------------------------------------------------------------*/
+
+void kk_async_post(kk_function_t callback, kk_context_t* ctx) {
+  kk_async_t* as = kk_async_get(ctx);
+  kk_async_ready_t* r = (kk_async_ready_t*)kk_malloc(kk_ssizeof(kk_async_ready_t), ctx);
+  if (r == NULL) kk_fatal_error(ENOMEM, "unable to post a callback");
+  r->next = NULL;
+  r->callback = callback;
+  if (as->ready_tail == NULL) as->ready = r;
+                         else as->ready_tail->next = r;
+  as->ready_tail = r;
+  as->ready_count++;
+}
+
+// Run the callbacks that are ready; callbacks posted meanwhile run on the next poll.
+static bool kk_async_ready_run(kk_async_t* as, kk_context_t* ctx) {
+  kk_async_ready_t* r = as->ready;
+  if (r == NULL) return false;
+  as->ready = as->ready_tail = NULL;
+  while (r != NULL) {
+    kk_async_ready_t* next = r->next;
+    kk_function_t callback = r->callback;
+    kk_free(r);
+    as->ready_count--;
+    kk_function_call(kk_unit_t, (kk_function_t, kk_context_t*), callback, (callback, ctx));
+    r = next;
+  }
+  return true;
+}
+
+
+/*--------------------------------------------------------------------------------------------------
+  Readiness of file descriptors
+--------------------------------------------------------------------------------------------------*/
+
+static void kk_async_watch_fire(kk_async_t* as, kk_async_watch_t* w, int err, kk_context_t* ctx) {
+#if KK_ASYNC_EPOLL
+  epoll_ctl(as->epfd, EPOLL_CTL_DEL, w->fd, NULL);
+#endif
+  as->watches--;
+  kk_function_t callback = w->callback;
+  kk_free(w);
+  kk_function_call(kk_unit_t, (kk_function_t, int32_t, kk_context_t*), callback, (callback, (int32_t)err, ctx));
+}
+
+void kk_async_watch_fd(int fd, bool write, kk_function_t callback, kk_context_t* ctx) {
+  kk_async_t* as = kk_async_get(ctx);
+  int err = ENOSYS;
+#if KK_ASYNC_EPOLL
+  if (as->epfd >= 0) {
+    kk_async_watch_t* w = (kk_async_watch_t*)kk_malloc(kk_ssizeof(kk_async_watch_t), ctx);
+    if (w == NULL) kk_fatal_error(ENOMEM, "unable to watch a file descriptor");
+    w->fd = fd;
+    w->callback = callback;
+    struct epoll_event ev;
+    ev.events = (write ? EPOLLOUT : EPOLLIN) | EPOLLONESHOT;
+    ev.data.ptr = w;
+    if (epoll_ctl(as->epfd, EPOLL_CTL_ADD, fd, &ev) == 0) {
+      as->watches++;
+      return;
+    }
+    err = errno;
+    kk_free(w);
+  }
+#else
+  KK_UNUSED(fd); KK_UNUSED(write);
+#endif
+  kk_function_call(kk_unit_t, (kk_function_t, int32_t, kk_context_t*), callback, (callback, (int32_t)err, ctx));
+}
+
+
+/*--------------------------------------------------------------------------------------------------
+  Failures of detached strands
+--------------------------------------------------------------------------------------------------*/
+
+void kk_async_set_failure(kk_box_t exn, kk_context_t* ctx) {
+  kk_async_t* as = kk_async_get(ctx);
+  if (kk_box_eq(as->failure, kk_box_null)) {
+    as->failure = exn;
+  }
+  else {
+    kk_box_drop(exn, ctx);
+  }
+}
+
+kk_box_t kk_async_take_failure(kk_context_t* ctx) {
+  kk_async_t* as = ctx->async;
+  if (as == NULL) return kk_box_null;
+  kk_box_t exn = as->failure;
+  as->failure = kk_box_null;
+  return exn;
+}
+
+
+/*--------------------------------------------------------------------------------------------------
+  The event loop
+--------------------------------------------------------------------------------------------------*/
+
+// Invoke the callbacks of completed requests, ready callbacks, and expired timers (without waiting).
+static bool kk_async_dispatch(kk_async_t* as, kk_context_t* ctx) {
+  bool progress = false;
+  kk_async_submit_backlog(as);
+  if (as->inflight > 0) {
+    kk_async_req_t* done;
+    const int err = kk_async_backend_reap(as, &done);
+    if (err != 0) kk_fatal_error(err, "unable to submit asynchronous I/O");
+    while (done != NULL) {
+      kk_async_req_t* next = done->next;
+      as->inflight--;
+      progress = true;
+      kk_async_req_complete(as, done, ctx);   // may invoke callbacks that submit new requests
+      done = next;
+    }
+    kk_async_submit_backlog(as);
+  }
+  if (kk_async_ready_run(as, ctx)) progress = true;
+  if (kk_async_timers_run(as, ctx)) progress = true;
+  return progress;
+}
+
+// Block until a request completes, a watched descriptor is ready, or `timeout` nano seconds have passed (if not negative).
+static void kk_async_block(kk_async_t* as, int64_t timeout, kk_context_t* ctx) {
+#if KK_ASYNC_EPOLL
+  if (as->epfd >= 0 && (as->inflight == 0 || as->pool == NULL || as->pool->notify >= 0)) {
+#if KK_ASYNC_URING
+    if (as->uring != NULL) {
+      const int err = kk_async_uring_enter(as->uring);
+      if (err != 0) kk_fatal_error(err, "unable to submit asynchronous I/O");
+    }
+#endif
+    // round up to milli seconds so we do not wake up before the first timer is due
+    const int timeout_ms = (timeout < 0 ? -1 : (timeout >= (int64_t)INT32_MAX * 1000000 ? INT32_MAX : (int)((timeout + 999999) / 1000000)));
+    struct epoll_event evs[16];
+    const int n = epoll_wait(as->epfd, evs, 16, timeout_ms);
+    if (n < 0) {
+      if (errno != EINTR) kk_fatal_error(errno, "unable to wait for events");
+      return;
+    }
+    for (int i = 0; i < n; i++) {
+      const uint64_t data = evs[i].data.u64;
+      if (data == KK_ASYNC_EV_URING) {
+        // completions are reaped by the next dispatch
+      }
+      else if (data == KK_ASYNC_EV_POOL) {
+        uint64_t count;
+        ssize_t nread = read(as->pool->notify, &count, sizeof(count));
+        KK_UNUSED(nread);
+      }
+      else {
+        const int err = ((evs[i].events & EPOLLERR) != 0 && (evs[i].events & (EPOLLIN | EPOLLOUT)) == 0 ? EIO : 0);
+        kk_async_watch_fire(as, (kk_async_watch_t*)evs[i].data.ptr, err, ctx);
+      }
+    }
+    return;
+  }
+#endif
+#if !defined(WIN32)
+  if (as->pool != NULL && as->inflight > 0) {
+    kk_async_pool_wait(as->pool, timeout);
+    return;
+  }
+#endif
+  if (timeout > 0) {
+    // only timers are pending
+#if defined(WIN32)
+    Sleep((DWORD)((timeout + 999999) / 1000000));
+#else
+    struct timespec ts;
+    ts.tv_sec = (time_t)(timeout / 1000000000);
+    ts.tv_nsec = (long)(timeout % 1000000000);
+    nanosleep(&ts, NULL);
+#endif
+  }
+}
+
+kk_ssize_t kk_async_poll(bool wait, kk_context_t* ctx) {
+  kk_async_t* as = ctx->async;
+  if (as == NULL) return 0;
+  const bool progress = kk_async_dispatch(as, ctx);
+  if (!progress && wait && kk_async_outstanding(as) > 0 && as->ready == NULL) {
+    int64_t timeout = -1;
+    if (as->timer_count > 0) {
+      timeout = as->timers[0].due - kk_async_now(ctx);
+      if (timeout < 0) timeout = 0;
+    }
+    if (timeout != 0) kk_async_block(as, timeout, ctx);
+    kk_async_dispatch(as, ctx);
+  }
+  return kk_async_outstanding(as);
+}
@@ -86,6 +86,73 @@ kk_bytes_t kk_bytes_adjust_length(kk_bytes_t b, kk_ssize_t newlen, kk_context_t*
 }
 
 
+/*--------------------------------------------------------------------------------------------------
+  Builders
+--------------------------------------------------------------------------------------------------*/
+
+// The capacity for a builder buffer of length `len`: the smallest power of 2 above `len` (so there
+// is always room for the terminating zero) with a minimum of 32 bytes.
+static kk_ssize_t kk_bytes_builder_capacity(kk_ssize_t len) {
+  if (len < 32) return 32;
+  return ((kk_ssize_t)1 << (KK_INTX_BITS - kk_bits_clz((kk_uintx_t)len)));
+}
+
+static kk_ssize_t kk_bytes_builder_alloc_size(kk_ssize_t capacity) {
+  return (kk_ssizeof(struct kk_bytes_normal_s) - 1 /* char buf[1] */ + capacity);
+}
+
+static kk_bytes_builder_block_t kk_bytes_builder_as(kk_datatype_t d) {
+  return kk_datatype_as_assert(kk_bytes_builder_block_t, d, KK_TAG_BYTES_BUILDER);
+}
+
+kk_bytes_builder_t kk_bytes_builder_reserve(kk_bytes_builder_t sb, kk_ssize_t extra, uint8_t** p, kk_context_t* ctx) {
+  kk_assert_internal(extra >= 0);
+  kk_datatype_t d = kk_datatype_unbox(sb);
+  if (kk_datatype_is_unique(d)) {
+    kk_bytes_builder_block_t b = kk_bytes_builder_as(d);
+    kk_bytes_t buf = kk_bytes_unbox(b->buf);
+    if (kk_datatype_is_unique(buf)) {
+      // in-place, and only reallocate when the capacity is exceeded
+      kk_bytes_normal_t nb = kk_datatype_as_assert(kk_bytes_normal_t, buf, KK_TAG_BYTES);
+      if (nb->length + extra >= b->capacity) {
+        const kk_ssize_t capacity = kk_bytes_builder_capacity(nb->length + extra);
+        nb = (kk_bytes_normal_t)kk_block_realloc(&nb->_base._block, kk_bytes_builder_alloc_size(capacity), ctx);
+        b->buf = kk_bytes_box(kk_datatype_from_base(&nb->_base));
+        b->capacity = capacity;
+      }
+      *p = &nb->buf[nb->length];
+      return sb;
+    }
+  }
+  // shared (or empty): copy into a fresh builder
+  kk_bytes_t buf = (kk_datatype_is_ptr(d) ? kk_bytes_dup(kk_bytes_unbox(kk_bytes_builder_as(d)->buf)) : kk_bytes_empty());
+  kk_ssize_t len;
+  const uint8_t* s = kk_bytes_buf_borrow(buf, &len);
+  const kk_ssize_t capacity = kk_bytes_builder_capacity(len + extra);
+  kk_bytes_normal_t nb = kk_block_assert(kk_bytes_normal_t, kk_block_alloc_any(kk_bytes_builder_alloc_size(capacity), 0, KK_TAG_BYTES, ctx), KK_TAG_BYTES);
+  if (len > 0) {
+    kk_memcpy(&nb->buf[0], s, len);
+  }
+  nb->length = len;
+  nb->buf[len] = 0;
+  kk_bytes_drop(buf, ctx);
+  kk_datatype_drop(d, ctx);
+  kk_bytes_builder_block_t b = kk_block_alloc_as(struct kk_bytes_builder_s, 1, KK_TAG_BYTES_BUILDER, ctx);
+  b->buf = kk_bytes_box(kk_datatype_from_base(&nb->_base));
+  b->capacity = capacity;
+  *p = &nb->buf[len];
+  return kk_datatype_box(kk_datatype_from_base(&b->_base));
+}
+
+kk_bytes_t kk_bytes_builder_build(kk_bytes_builder_t sb, kk_context_t* ctx) {
+  kk_datatype_t d = kk_datatype_unbox(sb);
+  if (!kk_datatype_is_ptr(d)) return kk_bytes_empty();
+  kk_bytes_t buf = kk_bytes_dup(kk_bytes_unbox(kk_bytes_builder_as(d)->buf));
+  kk_datatype_drop(d, ctx);  // if the builder was unique, `buf` is unique again
+  return buf;
+}
+
+
 /*--------------------------------------------------------------------------------------------------
   Compare
 --------------------------------------------------------------------------------------------------*/
@@ -124,6 +191,306 @@ int kk_bytes_cmp(kk_bytes_t b1, kk_bytes_t b2, kk_context_t* ctx) {
 }
 
 
+/*--------------------------------------------------------------------------------------------------
+  Ropes
+  Concatenating bytes longer than `KK_BYTES_ROPE_LEAF` creates a rope node instead of copying.
+  The rope nodes form an AVL tree (using the `depth` field) that is rebalanced on concatenation,
+  so repeated concatenation takes logarithmic time. Appending a short sequence to a rope copies
+  it into the last leaf (up to `KK_BYTES_ROPE_LEAF` bytes) to keep the number of leaves small.
+  The first time contiguous bytes are needed (through `kk_bytes_buf_borrow`) a rope is
+  flattened into its `flat` field. If the rope is not thread shared, this also releases its
+  children and the rope becomes a leaf; otherwise the children are kept (as other threads
+  may traverse them) and the flat bytes are published with an atomic compare-and-swap.
+--------------------------------------------------------------------------------------------------*/
+
+#define KK_BYTES_ROPE_LEAF  (512)
+
+static kk_bytes_t kk_bytes_cat_flat(kk_bytes_t b1, kk_bytes_t b2, kk_context_t* ctx);
+
+static inline kk_bytes_rope_t kk_rope_as(kk_bytes_t b) {
+  return kk_datatype_as_assert(kk_bytes_rope_t, b, KK_TAG_BYTES_ROPE);
+}
+
+static inline kk_bytes_t kk_rope_flat_borrow(kk_bytes_rope_t r) {
+  kk_bytes_t flat = { kk_atomic_load_acquire(&r->flat) };
+  return flat;
+}
+
+// Is this a rope that still has its children?
+static bool kk_rope_is_node(kk_bytes_t b) {
+  if (!kk_datatype_has_tag(b, KK_TAG_BYTES_ROPE)) return false;
+  kk_bytes_rope_t r = kk_rope_as(b);
+  return (r->_base._block.header.thread_shared != 0 || kk_datatype_is_singleton(kk_rope_flat_borrow(r)));
+}
+
+static kk_ssize_t kk_rope_depth(kk_bytes_t b) {
+  return (kk_rope_is_node(b) ? kk_rope_as(b)->depth : 0);
+}
+
+static kk_bytes_t kk_rope_left_borrow(kk_bytes_t b) {
+  return kk_bytes_unbox(kk_rope_as(b)->left);
+}
+
+static kk_bytes_t kk_rope_right_borrow(kk_bytes_t b) {
+  return kk_bytes_unbox(kk_rope_as(b)->right);
+}
+
+static kk_bytes_t kk_rope_node(kk_bytes_t left, kk_bytes_t right, kk_context_t* ctx) {
+  kk_assert_internal(!kk_bytes_is_empty_borrow(left) && !kk_bytes_is_empty_borrow(right));
+  const kk_ssize_t dleft  = kk_rope_depth(left);
+  const kk_ssize_t dright = kk_rope_depth(right);
+  kk_bytes_rope_t r = kk_block_alloc_as(struct kk_bytes_rope_s, 3, KK_TAG_BYTES_ROPE, ctx);
+  r->length = kk_bytes_len_borrow(left) + kk_bytes_len_borrow(right);
+  r->depth  = 1 + (dleft >= dright ? dleft : dright);
+  r->left   = kk_bytes_box(left);
+  r->right  = kk_bytes_box(right);
+  kk_atomic_store_relaxed(&r->flat, kk_bytes_empty().dbox);
+  return kk_datatype_from_base(&r->_base);
+}
+
+// Take the children of a rope node (and consume the node)
+static void kk_rope_split(kk_bytes_t b, kk_bytes_t* left, kk_bytes_t* right, kk_context_t* ctx) {
+  kk_assert_internal(kk_rope_is_node(b));
+  kk_bytes_rope_t r = kk_rope_as(b);
+  *left  = kk_bytes_unbox(r->left);
+  *right = kk_bytes_unbox(r->right);
+  if (kk_datatype_is_unique(b)) {
+    kk_bytes_drop(kk_rope_flat_borrow(r), ctx);  // (only if flattened while thread shared)
+    kk_block_free(&r->_base._block);
+  }
+  else {
+    kk_bytes_dup(*left);
+    kk_bytes_dup(*right);
+    kk_bytes_drop(b, ctx);
+  }
+}
+
+// Join two ropes whose depth may differ by more than one (see "Just Join for Parallel
+// Ordered Sets", Guy Blelloch, Daniel Ferizovic, and Yihan Sun, 2016).
+static kk_bytes_t kk_rope_join(kk_bytes_t l, kk_bytes_t r, kk_context_t* ctx) {
+  const kk_ssize_t dl = kk_rope_depth(l);
+  const kk_ssize_t dr = kk_rope_depth(r);
+  if (dl > dr + 1) {
+    kk_bytes_t ll, lr, tl, tr;
+    kk_rope_split(l, &ll, &lr, ctx);
+    kk_bytes_t t = kk_rope_join(lr, r, ctx);
+    if (kk_rope_depth(t) <= kk_rope_depth(ll) + 1) return kk_rope_node(ll, t, ctx);
+    kk_rope_split(t, &tl, &tr, ctx);
+    if (kk_rope_depth(tl) <= kk_rope_depth(tr)) {
+      return kk_rope_node(kk_rope_node(ll, tl, ctx), tr, ctx);    // rotate left
+    }
+    else {
+      kk_bytes_t tll, tlr;
+      kk_rope_split(tl, &tll, &tlr, ctx);
+      return kk_rope_node(kk_rope_node(ll, tll, ctx), kk_rope_node(tlr, tr, ctx), ctx);  // double rotation
+    }
+  }
+  else if (dr > dl + 1) {
+    kk_bytes_t rl, rr, tl, tr;
+    kk_rope_split(r, &rl, &rr, ctx);
+    kk_bytes_t t = kk_rope_join(l, rl, ctx);
+    if (kk_rope_depth(t) <= kk_rope_depth(rr) + 1) return kk_rope_node(t, rr, ctx);
+    kk_rope_split(t, &tl, &tr, ctx);
+    if (kk_rope_depth(tr) <= kk_rope_depth(tl)) {
+      return kk_rope_node(tl, kk_rope_node(tr, rr, ctx), ctx);    // rotate right
+    }
+    else {
+      kk_bytes_t trl, trr;
+      kk_rope_split(tr, &trl, &trr, ctx);
+      return kk_rope_node(kk_rope_node(tl, trl, ctx), kk_rope_node(trr, rr, ctx), ctx);
+    }
+  }
+  else {
+    return kk_rope_node(l, r, ctx);
+  }
+}
+
+static kk_bytes_t kk_bytes_rope_cat(kk_bytes_t b1, kk_ssize_t len1, kk_bytes_t b2, kk_ssize_t len2, kk_context_t* ctx) {
+  if (kk_rope_is_node(b1)) {
+    // append to the last leaf if it stays short
+    kk_bytes_t last = kk_rope_right_borrow(b1);
+    if (!kk_rope_is_node(last) && kk_bytes_len_borrow(last) + len2 <= KK_BYTES_ROPE_LEAF) {
+      kk_bytes_t left, right;
+      kk_rope_split(b1, &left, &right, ctx);
+      return kk_rope_node(left, kk_bytes_cat_flat(right, b2, ctx), ctx);
+    }
+  }
+  if (kk_rope_is_node(b2)) {
+    // prepend to the first leaf if it stays short
+    kk_bytes_t first = kk_rope_left_borrow(b2);
+    if (!kk_rope_is_node(first) && len1 + kk_bytes_len_borrow(first) <= KK_BYTES_ROPE_LEAF) {
+      kk_bytes_t left, right;
+      kk_rope_split(b2, &left, &right, ctx);
+      return kk_rope_node(kk_bytes_cat_flat(b1, left, ctx), right, ctx);
+    }
+  }
+  return kk_rope_join(b1, b2, ctx);
+}
+
+bool kk_bytes_foreach_chunk_borrow(const kk_bytes_t b, kk_bytes_chunk_fun_t* fun, void* arg) {
+  if (kk_rope_is_node(b)) {
+    kk_bytes_rope_t r = kk_rope_as(b);
+    kk_bytes_t flat = kk_rope_flat_borrow(r);
+    if (!kk_datatype_is_singleton(flat)) {
+      return kk_bytes_foreach_chunk_borrow(flat, fun, arg);  // thread shared and flattened
+    }
+    return (kk_bytes_foreach_chunk_borrow(kk_bytes_unbox(r->left), fun, arg) &&
+            kk_bytes_foreach_chunk_borrow(kk_bytes_unbox(r->right), fun, arg));
+  }
+  else {
+    kk_ssize_t len;
+    const uint8_t* buf = kk_bytes_buf_borrow(b, &len);
+    return (len <= 0 || fun(buf, len, arg));
+  }
+}
+
+static bool kk_rope_copy_chunk(const uint8_t* buf, kk_ssize_t len, void* arg) {
+  uint8_t** p = (uint8_t**)arg;
+  kk_memcpy(*p, buf, len);
+  *p += len;
+  return true;
+}
+
+const uint8_t* kk_bytes_rope_buf_borrow(const kk_bytes_t b, kk_ssize_t* len) {
+  kk_bytes_rope_t r = kk_rope_as(b);
+  kk_bytes_t flat = kk_rope_flat_borrow(r);
+  if (kk_datatype_is_singleton(flat)) {
+    kk_context_t* ctx = kk_get_context();
+    uint8_t* buf;
+    flat = kk_bytes_alloc_buf(r->length, &buf, ctx);
+    uint8_t* p = buf;
+    kk_bytes_foreach_chunk_borrow(b, &kk_rope_copy_chunk, &p);
+    kk_assert_internal(p == buf + r->length);
+    if (r->_base._block.header.thread_shared == 0) {
+      kk_atomic_store_relaxed(&r->flat, flat.dbox);
+      kk_box_drop(r->left, ctx);
+      kk_box_drop(r->right, ctx);
+      r->left  = kk_bytes_box(kk_bytes_empty());
+      r->right = kk_bytes_box(kk_bytes_empty());
+    }
+    else {
+      kk_block_mark_shared(kk_datatype_as_ptr(flat), ctx);
+      uintptr_t expected = kk_bytes_empty().dbox;
+      if (!kk_atomic_cas_strong_acq_rel(&r->flat, &expected, flat.dbox)) {
+        // flattened by another thread in the mean time
+        kk_bytes_drop(flat, ctx);
+        flat.dbox = expected;
+      }
+    }
+  }
+  return kk_bytes_buf_borrow(flat, len);
+}
+
+
+/*--------------------------------------------------------------------------------------------------
+  Views
+  A view refers to a range of bytes in its parent (which is never a view itself) such that 
+  splitting and slicing take constant time per part. Views shorter than `KK_BYTES_VIEW_MIN` are 
+  copied instead. Since a view is not zero terminated in general, `kk_bytes_cbuf_borrow` copies
+  the bytes the first time a C string is needed. If the view is not thread shared, the copy 
+  becomes the new parent (and the old parent is released); otherwise the copy is published
+  in the `flat` field with an atomic compare-and-swap.
+--------------------------------------------------------------------------------------------------*/
+
+static inline kk_bytes_view_t kk_view_as(kk_bytes_t b) {
+  return kk_datatype_as_assert(kk_bytes_view_t, b, KK_TAG_BYTES_VIEW);
+}
+
+kk_bytes_t kk_bytes_view(kk_bytes_t b, kk_ssize_t start, kk_ssize_t len, kk_context_t* ctx) {
+  kk_ssize_t blen;
+  const uint8_t* buf = kk_bytes_buf_borrow(b, &blen);  // (flattens ropes)
+  kk_assert_internal(start >= 0 && len >= 0 && start + len <= blen);
+  if (start == 0 && len == blen) {
+    return b;
+  }
+  else if (len < KK_BYTES_VIEW_MIN) {
+    kk_bytes_t t = kk_bytes_alloc_dupn(len, buf + start, ctx);
+    kk_bytes_drop(b, ctx);
+    return t;
+  }
+  kk_bytes_t parent = b;
+  if (kk_datatype_has_tag(b, KK_TAG_BYTES_VIEW)) {
+    // view on the parent directly
+    parent = kk_bytes_dup(kk_bytes_unbox(kk_view_as(b)->parent));
+    kk_bytes_drop(b, ctx);
+  }
+  kk_bytes_view_t v = kk_block_alloc_as(struct kk_bytes_view_s, 2, KK_TAG_BYTES_VIEW, ctx);
+  v->parent = kk_bytes_box(parent);
+  kk_atomic_store_relaxed(&v->flat, kk_bytes_empty().dbox);
+  v->cbuf = buf + start;
+  v->length = len;
+  return kk_datatype_from_base(&v->_base);
+}
+
+// Store a zero terminated copy of `buf` in `*pflat` (unless another thread did so first).
+static kk_bytes_t kk_bytes_flat_copy(_Atomic(uintptr_t)* pflat, const uint8_t* buf, kk_ssize_t len, bool shared, kk_context_t* ctx) {
+  kk_bytes_t flat = kk_bytes_alloc_dupn(len, buf, ctx);
+  if (!shared) {
+    kk_atomic_store_relaxed(pflat, flat.dbox);
+  }
+  else {
+    kk_block_mark_shared(kk_datatype_as_ptr(flat), ctx);
+    uintptr_t expected = kk_bytes_empty().dbox;
+    if (!kk_atomic_cas_strong_acq_rel(pflat, &expected, flat.dbox)) {
+      // copied by another thread in the mean time
+      kk_bytes_drop(flat, ctx);
+      flat.dbox = expected;
+    }
+  }
+  return flat;
+}
+
+static const uint8_t* kk_bytes_view_cbuf_borrow(const kk_bytes_t b, kk_ssize_t* len) {
+  kk_bytes_view_t v = kk_view_as(b);
+  // a view that ends where its (non-raw) parent ends is zero terminated already
+  if (!kk_datatype_has_tag(kk_bytes_unbox(v->parent), KK_TAG_BYTES_RAW) && v->cbuf[v->length] == 0) {
+    if (len != NULL) *len = v->length;
+    return v->cbuf;
+  }
+  kk_bytes_t flat = { kk_atomic_load_acquire(&v->flat) };
+  if (kk_datatype_is_singleton(flat)) {
+    kk_context_t* ctx = kk_get_context();
+    if (v->_base._block.header.thread_shared == 0) {
+      flat = kk_bytes_alloc_dupn(v->length, v->cbuf, ctx);
+      kk_box_drop(v->parent, ctx);
+      v->parent = kk_bytes_box(flat);
+      v->cbuf = kk_bytes_buf_borrow(flat, NULL);
+      if (len != NULL) *len = v->length;
+      return v->cbuf;
+    }
+    flat = kk_bytes_flat_copy(&v->flat, v->cbuf, v->length, true, ctx);
+  }
+  return kk_bytes_buf_borrow(flat, len);
+}
+
+// Raw bytes point to an external buffer that is not zero terminated in general;
+// the first time we need a C string we keep a zero terminated copy in the `flat` field.
+static const uint8_t* kk_bytes_raw_cbuf_borrow(const kk_bytes_t b, kk_ssize_t* len) {
+  kk_bytes_raw_t r = kk_datatype_as_assert(kk_bytes_raw_t, b, KK_TAG_BYTES_RAW);
+  kk_bytes_t flat = { kk_atomic_load_acquire(&r->flat) };
+  if (kk_datatype_is_singleton(flat)) {
+    flat = kk_bytes_flat_copy(&r->flat, r->cbuf, r->length, r->_base._block.header.thread_shared != 0, kk_get_context());
+  }
+  return kk_bytes_buf_borrow(flat, len);
+}
+
+const uint8_t* kk_bytes_copy_cbuf_borrow(const kk_bytes_t b, kk_ssize_t* len) {
+  if (kk_datatype_has_tag(b, KK_TAG_BYTES_RAW)) {
+    return kk_bytes_raw_cbuf_borrow(b, len);
+  }
+  else {
+    return kk_bytes_view_cbuf_borrow(b, len);
+  }
+}
+
+// Release the zero terminated copy of raw bytes (called when the raw bytes are freed).
+void kk_bytes_raw_free_flat(kk_block_t* b, kk_context_t* ctx) {
+  kk_bytes_raw_t r = kk_block_assert(kk_bytes_raw_t, b, KK_TAG_BYTES_RAW);
+  kk_bytes_t flat = { kk_atomic_load_relaxed(&r->flat) };
+  kk_bytes_drop(flat, ctx);
+}
+
+
 /*--------------------------------------------------------------------------------------------------
   Utilities
 --------------------------------------------------------------------------------------------------*/
@@ -149,7 +516,7 @@ kk_ssize_t kk_decl_pure kk_bytes_count_pattern_borrow(kk_bytes_t b, kk_bytes_t p
 }
 
 
-kk_bytes_t kk_bytes_cat(kk_bytes_t b1, kk_bytes_t b2, kk_context_t* ctx) {
+static kk_bytes_t kk_bytes_cat_flat(kk_bytes_t b1, kk_bytes_t b2, kk_context_t* ctx) {
   kk_ssize_t len1;
   const uint8_t* s1 = kk_bytes_buf_borrow(b1, &len1);
   kk_ssize_t len2;
@@ -164,6 +531,25 @@ kk_bytes_t kk_bytes_cat(kk_bytes_t b1, kk_bytes_t b2, kk_context_t* ctx) {
   return t;
 }
 
+kk_bytes_t kk_bytes_cat(kk_bytes_t b1, kk_bytes_t b2, kk_context_t* ctx) {
+  const kk_ssize_t len1 = kk_bytes_len_borrow(b1);
+  const kk_ssize_t len2 = kk_bytes_len_borrow(b2);
+  if (len2 == 0) {
+    kk_bytes_drop(b2, ctx);
+    return b1;
+  }
+  else if (len1 == 0) {
+    kk_bytes_drop(b1, ctx);
+    return b2;
+  }
+  else if (len1 + len2 <= KK_BYTES_ROPE_LEAF) {
+    return kk_bytes_cat_flat(b1, b2, ctx);
+  }
+  else {
+    return kk_bytes_rope_cat(b1, len1, b2, len2, ctx);
+  }
+}
+
 kk_bytes_t kk_bytes_cat_from_buf(kk_bytes_t b1, kk_ssize_t len2, const uint8_t* b2, kk_context_t* ctx) {
   if (b2 == NULL || len2 <= 0) return b1;
   kk_ssize_t len1;
@@ -219,12 +605,11 @@ kk_vector_t kk_bytes_splitv_atmost(kk_bytes_t b, kk_bytes_t sepb, kk_ssize_t n,
     }
     kk_assert_internal(r != NULL && r >= p && r < end);    
     const kk_ssize_t partlen = (r - p);
-    v[i] = kk_bytes_box(kk_bytes_alloc_dupn(partlen, p, ctx));
+    v[i] = kk_bytes_box(kk_bytes_view(kk_bytes_dup(b), p - s, partlen, ctx));
     p = r + seplen;  // advance
   }
   kk_assert_internal(p <= end);
-  v[count-1] = kk_bytes_box(kk_bytes_alloc_dupn(end - p, p, ctx));  // todo: share bytes if p == s ?
-  kk_bytes_drop(b,ctx);
+  v[count-1] = kk_bytes_box(kk_bytes_view(b, p - s, end - p, ctx));
   kk_bytes_drop(sepb, ctx);
   return vec;
 }
@@ -247,7 +632,7 @@ kk_bytes_t kk_bytes_replace_atmost(kk_bytes_t s, kk_bytes_t pat, kk_bytes_t rep,
     const uint8_t* const pend = p + plen;
     // if unique s && |rep| == |pat|, update in-place
     // TODO: if unique s & |rep| <= |pat|, maybe update in-place if not too much waste?
-    if (kk_datatype_is_unique(s) && ppat_len == prep_len) {
+    if (kk_bytes_is_unique_owned(s) && ppat_len == prep_len) {
       kk_ssize_t count = 0;
       while (count < n && p < pend) {
         const uint8_t* r = kk_memmem(p, pend - p, ppat, ppat_len);
@@ -0,0 +1,415 @@
+/*---------------------------------------------------------------------------
+  Copyright 2021, Microsoft Research, Daan Leijen.
+
+  This is free software; you can redistribute it and/or modify it under the
+  terms of the Apache License, Version 2.0. A copy of the License can be
+  found in the LICENSE file at the root of this distribution.
+---------------------------------------------------------------------------*/
+#include "kklib.h"
+
+/*--------------------------------------------------------------------------------------------------
+  Mutable hash tables using open addressing with control bytes (in the style of the "SwissTable"
+  of Abseil). Every slot has a control byte that is either `EMPTY`, `DELETED`, or holds the top
+  7 bits of the hash (`h2`) of the key in that slot. Slots are probed in groups of 16 whose
+  control bytes are matched against `h2` at once using SSE2 (x64) or NEON (arm64) instructions,
+  so the (Koka) equality function is only called for likely candidates. Groups are probed
+  in triangular order and a probe sequence ends at the first group that has an `EMPTY` slot.
+  We also store the 32-bit hash of each key: this filters out most false `h2` matches and
+  means we never call the (Koka) hash function again when the table is resized.
+  The table is resized when more than 7/8 of the slots are used (or deleted).
+--------------------------------------------------------------------------------------------------*/
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define KK_HT_SSE2  1
+#include <emmintrin.h>
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#define KK_HT_NEON  1
+#include <arm_neon.h>
+#endif
+
+#define KK_HT_GROUP     (16)
+#define KK_HT_EMPTY     ((uint8_t)0x80)
+#define KK_HT_DELETED   ((uint8_t)0xFE)
+
+typedef struct kk_htable_s {
+  kk_function_t hash;
+  kk_function_t eq;
+  kk_ssize_t    capacity;     // a power of two multiple of `KK_HT_GROUP`
+  kk_ssize_t    count;        // number of keys in the table
+  kk_ssize_t    growth_left;  // number of `EMPTY` slots that can be used before resizing
+  kk_ssize_t    generation;   // incremented whenever existing slots are moved or freed
+  kk_box_t*     keys;
+  kk_box_t*     values;
+  uint32_t*     hashes;
+  uint8_t*      ctrl;         // control bytes (the arrays are allocated as one block at `keys`)
+} kk_htable_t;
+
+static kk_ssize_t kk_htable_max_load(kk_ssize_t capacity) {
+  return (capacity - capacity/8);
+}
+
+static kk_htable_t* kk_htable_unbox(kk_hashtable_t t) {
+  return (kk_htable_t*)kk_cptr_raw_unbox(t);
+}
+
+
+/*--------------------------------------------------------------------------------------------------
+  Matching a group of control bytes.
+  A match returns a bit mask where each matched slot `i` has bit `i << KK_HT_MASK_SHIFT` set.
+--------------------------------------------------------------------------------------------------*/
+
+#if KK_HT_SSE2
+#define KK_HT_MASK_SHIFT  0
+
+static inline uint64_t kk_group_match(const uint8_t* g, uint8_t h2) {
+  __m128i ctrl = _mm_loadu_si128((const __m128i*)g);
+  return (uint16_t)_mm_movemask_epi8(_mm_cmpeq_epi8(ctrl, _mm_set1_epi8((char)h2)));
+}
+
+static inline uint64_t kk_group_match_empty(const uint8_t* g) {
+  return kk_group_match(g, KK_HT_EMPTY);
+}
+
+// `EMPTY` or `DELETED` (the only control bytes with the high bit set)
+static inline uint64_t kk_group_match_free(const uint8_t* g) {
+  return (uint16_t)_mm_movemask_epi8(_mm_loadu_si128((const __m128i*)g));
+}
+
+#elif KK_HT_NEON
+#define KK_HT_MASK_SHIFT  2   // 4 bits per slot
+
+static inline uint64_t kk_neon_mask(uint8x16_t m) {
+  // narrow each byte to 4 bits
+  uint8x8_t nibbles = vshrn_n_u16(vreinterpretq_u16_u8(m), 4);
+  return (vget_lane_u64(vreinterpret_u64_u8(nibbles), 0) & KU64(0x8888888888888888));
+}
+
+static inline uint64_t kk_group_match(const uint8_t* g, uint8_t h2) {
+  return kk_neon_mask(vceqq_u8(vld1q_u8(g), vdupq_n_u8(h2)));
+}
+
+static inline uint64_t kk_group_match_empty(const uint8_t* g) {
+  return kk_group_match(g, KK_HT_EMPTY);
+}
+
+static inline uint64_t kk_group_match_free(const uint8_t* g) {
+  return kk_neon_mask(vtstq_u8(vld1q_u8(g), vdupq_n_u8(0x80)));
+}
+
+#else
+#define KK_HT_MASK_SHIFT  0
+
+static inline uint64_t kk_group_match(const uint8_t* g, uint8_t h2) {
+  uint64_t m = 0;
+  for (int i = 0; i < KK_HT_GROUP; i++) {
+    if (g[i] == h2) m |= (KU64(1) << i);
+  }
+  return m;
+}
+
+static inline uint64_t kk_group_match_empty(const uint8_t* g) {
+  return kk_group_match(g, KK_HT_EMPTY);
+}
+
+static inline uint64_t kk_group_match_free(const uint8_t* g) {
+  uint64_t m = 0;
+  for (int i = 0; i < KK_HT_GROUP; i++) {
+    if ((g[i] & 0x80) != 0) m |= (KU64(1) << i);
+  }
+  return m;
+}
+#endif
+
+static inline kk_ssize_t kk_group_lane(uint64_t m) {
+  return (kk_ssize_t)(kk_bits_ctz64(m) >> KK_HT_MASK_SHIFT);
+}
+
+
+/*--------------------------------------------------------------------------------------------------
+  Probing
+--------------------------------------------------------------------------------------------------*/
+
+typedef struct kk_probe_s {
+  kk_ssize_t group;   // current group
+  kk_ssize_t mask;    // number of groups - 1
+  kk_ssize_t step;
+} kk_probe_t;
+
+static inline uint64_t kk_htable_mix(uint32_t hash) {
+  return kk_bits_mix64(hash);
+}
+
+static inline uint8_t kk_htable_h2(uint64_t h) {
+  return (uint8_t)(h >> 57);
+}
+
+static inline kk_probe_t kk_probe_start(const kk_htable_t* t, uint64_t h) {
+  kk_probe_t p;
+  p.mask  = (t->capacity / KK_HT_GROUP) - 1;
+  p.group = (kk_ssize_t)(h & (uint64_t)p.mask);
+  p.step  = 0;
+  return p;
+}
+
+// triangular probing visits every group as the number of groups is a power of two
+static inline void kk_probe_next(kk_probe_t* p) {
+  p->step++;
+  p->group = (p->group + p->step) & p->mask;
+}
+
+static uint32_t kk_htable_hash(kk_htable_t* t, kk_box_t key, kk_context_t* ctx) {
+  kk_function_dup(t->hash);
+  kk_box_dup(key);
+  return (uint32_t)kk_function_call(int32_t, (kk_function_t, kk_box_t, kk_context_t*), t->hash, (t->hash, key, ctx));
+}
+
+static bool kk_htable_eq(kk_htable_t* t, kk_box_t x, kk_box_t y, kk_context_t* ctx) {
+  kk_function_dup(t->eq);
+  kk_box_dup(x);
+  kk_box_dup(y);
+  return kk_function_call(bool, (kk_function_t, kk_box_t, kk_box_t, kk_context_t*), t->eq, (t->eq, x, y, ctx));
+}
+
+// Find the slot of `key` (borrowed) with hash `hash`, or return -1.
+static kk_ssize_t kk_htable_find(kk_htable_t* t, kk_box_t key, uint32_t hash, kk_context_t* ctx) {
+  const uint64_t h = kk_htable_mix(hash);
+  const uint8_t h2 = kk_htable_h2(h);
+  kk_probe_t p = kk_probe_start(t, h);
+  while (true) {
+    const uint8_t* g = t->ctrl + (p.group * KK_HT_GROUP);
+    for (uint64_t m = kk_group_match(g, h2); m != 0; m &= (m - 1)) {
+      const kk_ssize_t slot = (p.group * KK_HT_GROUP) + kk_group_lane(m);
+      if (t->hashes[slot] == hash && kk_htable_eq(t, key, t->keys[slot], ctx)) return slot;
+    }
+    if (kk_group_match_empty(g) != 0) return -1;
+    kk_probe_next(&p);
+  }
+}
+
+// Find the first `EMPTY` or `DELETED` slot for a key with hash `hash`.
+static kk_ssize_t kk_htable_find_free(const kk_htable_t* t, uint32_t hash) {
+  kk_probe_t p = kk_probe_start(t, kk_htable_mix(hash));
+  while (true) {
+    const uint64_t m = kk_group_match_free(t->ctrl + (p.group * KK_HT_GROUP));
+    if (m != 0) return (p.group * KK_HT_GROUP) + kk_group_lane(m);
+    kk_probe_next(&p);
+  }
+}
+
+
+/*--------------------------------------------------------------------------------------------------
+  Allocation and resizing
+--------------------------------------------------------------------------------------------------*/
+
+static void kk_htable_alloc_slots(kk_htable_t* t, kk_ssize_t capacity, kk_context_t* ctx) {
+  kk_assert_internal(capacity >= KK_HT_GROUP && (capacity & (capacity - 1)) == 0);
+  const kk_ssize_t size = capacity * (2*kk_ssizeof(kk_box_t) + kk_ssizeof(uint32_t) + 1);
+  uint8_t* p = (uint8_t*)kk_malloc(size, ctx);
+  if (p == NULL) kk_fatal_error(ENOMEM, "unable to allocate the slots of a hash table");
+  t->capacity    = capacity;
+  t->growth_left = kk_htable_max_load(capacity) - t->count;
+  t->keys   = (kk_box_t*)p;
+  t->values = t->keys + capacity;
+  t->hashes = (uint32_t*)(t->values + capacity);
+  t->ctrl   = (uint8_t*)(t->hashes + capacity);
+  memset(t->ctrl, KK_HT_EMPTY, (size_t)capacity);
+}
+
+static void kk_htable_set_ctrl(kk_htable_t* t, kk_ssize_t slot, uint32_t hash) {
+  t->ctrl[slot] = kk_htable_h2(kk_htable_mix(hash));
+}
+
+// Resize to a larger table (or rehash in place if there are many deleted slots) and
+// move all entries without calling the hash function again.
+static void kk_htable_resize(kk_htable_t* t, kk_context_t* ctx) {
+  const kk_ssize_t capacity = t->capacity;
+  kk_box_t* keys   = t->keys;
+  kk_box_t* values = t->values;
+  uint32_t* hashes = t->hashes;
+  uint8_t*  ctrl   = t->ctrl;
+  const kk_ssize_t newcap = (t->count >= kk_htable_max_load(capacity)/2 ? 2*capacity : capacity);
+  t->generation++;
+  kk_htable_alloc_slots(t, newcap, ctx);
+  for (kk_ssize_t i = 0; i < capacity; i++) {
+    if ((ctrl[i] & 0x80) == 0) {
+      const kk_ssize_t slot = kk_htable_find_free(t, hashes[i]);
+      kk_htable_set_ctrl(t, slot, hashes[i]);
+      t->hashes[slot] = hashes[i];
+      t->keys[slot]   = keys[i];
+      t->values[slot] = values[i];
+    }
+  }
+  kk_free(keys);
+}
+
+static void kk_htable_drop_entries(kk_htable_t* t, kk_context_t* ctx) {
+  for (kk_ssize_t i = 0; i < t->capacity; i++) {
+    if ((t->ctrl[i] & 0x80) == 0) {
+      kk_box_drop(t->keys[i], ctx);
+      kk_box_drop(t->values[i], ctx);
+    }
+  }
+}
+
+static void kk_hashtable_free(void* p, kk_block_t* b, kk_context_t* ctx) {
+  KK_UNUSED(b);
+  kk_htable_t* t = (kk_htable_t*)p;
+  kk_htable_drop_entries(t, ctx);
+  kk_function_drop(t->hash, ctx);
+  kk_function_drop(t->eq, ctx);
+  kk_free(t->keys);
+  kk_free(t);
+}
+
+kk_hashtable_t kk_hashtable_alloc(kk_function_t hash, kk_function_t eq, kk_context_t* ctx) {
+  kk_htable_t* t = (kk_htable_t*)kk_zalloc(kk_ssizeof(kk_htable_t), ctx);
+  if (t == NULL) kk_fatal_error(ENOMEM, "unable to allocate a hash table");
+  t->hash = hash;
+  t->eq = eq;
+  kk_htable_alloc_slots(t, KK_HT_GROUP, ctx);
+  return kk_cptr_raw_box(&kk_hashtable_free, t, ctx);
+}
+
+kk_unit_t kk_hashtable_clear(kk_hashtable_t t, kk_context_t* ctx) {
+  kk_htable_t* ht = kk_htable_unbox(t);
+  kk_htable_drop_entries(ht, ctx);
+  ht->count = 0;
+  ht->generation++;
+  ht->growth_left = kk_htable_max_load(ht->capacity);
+  memset(ht->ctrl, KK_HT_EMPTY, (size_t)ht->capacity);
+  return kk_Unit;
+}
+
+kk_ssize_t kk_hashtable_count(kk_hashtable_t t, kk_context_t* ctx) {
+  KK_UNUSED(ctx);
+  return kk_htable_unbox(t)->count;
+}
+
+kk_ssize_t kk_hashtable_generation(kk_hashtable_t t, kk_context_t* ctx) {
+  KK_UNUSED(ctx);
+  return kk_htable_unbox(t)->generation;
+}
+
+
+/*--------------------------------------------------------------------------------------------------
+  Lookup, insertion, and removal
+--------------------------------------------------------------------------------------------------*/
+
+kk_ssize_t kk_hashtable_find(kk_hashtable_t t, kk_box_t key, kk_context_t* ctx) {
+  kk_htable_t* ht = kk_htable_unbox(t);
+  const kk_ssize_t slot = kk_htable_find(ht, key, kk_htable_hash(ht, key, ctx), ctx);
+  kk_box_drop(key, ctx);
+  return slot;
+}
+
+// Insert a key that is not yet in the table and return its slot.
+static kk_ssize_t kk_htable_insert_new(kk_htable_t* t, kk_box_t key, uint32_t hash, kk_box_t value, kk_context_t* ctx) {
+  kk_ssize_t slot = kk_htable_find_free(t, hash);
+  if (t->ctrl[slot] == KK_HT_EMPTY) {
+    if (t->growth_left == 0) {
+      kk_htable_resize(t, ctx);
+      slot = kk_htable_find_free(t, hash);
+    }
+    t->growth_left--;
+  }
+  kk_htable_set_ctrl(t, slot, hash);
+  t->hashes[slot] = hash;
+  t->keys[slot]   = key;
+  t->values[slot] = value;
+  t->count++;
+  return slot;
+}
+
+kk_ssize_t kk_hashtable_find_or_insert(kk_hashtable_t t, kk_box_t key, kk_box_t init, kk_context_t* ctx) {
+  kk_htable_t* ht = kk_htable_unbox(t);
+  const uint32_t hash = kk_htable_hash(ht, key, ctx);
+  const kk_ssize_t slot = kk_htable_find(ht, key, hash, ctx);
+  if (slot >= 0) {
+    kk_box_drop(key, ctx);
+    kk_box_drop(init, ctx);
+    return slot;
+  }
+  return kk_htable_insert_new(ht, key, hash, init, ctx);
+}
+
+kk_unit_t kk_hashtable_insert(kk_hashtable_t t, kk_box_t key, kk_box_t value, kk_context_t* ctx) {
+  kk_htable_t* ht = kk_htable_unbox(t);
+  const uint32_t hash = kk_htable_hash(ht, key, ctx);
+  const kk_ssize_t slot = kk_htable_find(ht, key, hash, ctx);
+  if (slot >= 0) {
+    kk_box_drop(key, ctx);
+    kk_box_drop(ht->values[slot], ctx);
+    ht->values[slot] = value;
+  }
+  else {
+    kk_htable_insert_new(ht, key, hash, value, ctx);
+  }
+  return kk_Unit;
+}
+
+bool kk_hashtable_remove(kk_hashtable_t t, kk_box_t key, kk_context_t* ctx) {
+  kk_htable_t* ht = kk_htable_unbox(t);
+  const kk_ssize_t slot = kk_htable_find(ht, key, kk_htable_hash(ht, key, ctx), ctx);
+  kk_box_drop(key, ctx);
+  if (slot < 0) return false;
+  kk_box_drop(ht->keys[slot], ctx);
+  kk_box_drop(ht->values[slot], ctx);
+  ht->count--;
+  ht->generation++;
+  // A group that has an `EMPTY` slot was never full, so no probe sequence continued past
+  // it and we can mark the slot `EMPTY` again; otherwise it must become `DELETED`.
+  const kk_ssize_t group = (slot / KK_HT_GROUP) * KK_HT_GROUP;
+  if (kk_group_match_empty(ht->ctrl + group) != 0) {
+    ht->ctrl[slot] = KK_HT_EMPTY;
+    ht->growth_left++;
+  }
+  else {
+    ht->ctrl[slot] = KK_HT_DELETED;
+  }
+  return true;
+}
+
+
+/*--------------------------------------------------------------------------------------------------
+  Slots
+--------------------------------------------------------------------------------------------------*/
+
+kk_ssize_t kk_hashtable_next(kk_hashtable_t t, kk_ssize_t slot, kk_context_t* ctx) {
+  KK_UNUSED(ctx);
+  const kk_htable_t* ht = kk_htable_unbox(t);
+  for (kk_ssize_t i = (slot < 0 ? 0 : slot); i < ht->capacity; i++) {
+    if ((ht->ctrl[i] & 0x80) == 0) return i;
+  }
+  return -1;
+}
+
+kk_box_t kk_hashtable_slot_key(kk_hashtable_t t, kk_ssize_t slot, kk_context_t* ctx) {
+  KK_UNUSED(ctx);
+  const kk_htable_t* ht = kk_htable_unbox(t);
+  kk_assert(slot >= 0 && slot < ht->capacity && (ht->ctrl[slot] & 0x80) == 0);
+  return kk_box_dup(ht->keys[slot]);
+}
+
+kk_box_t kk_hashtable_slot_value(kk_hashtable_t t, kk_ssize_t slot, kk_context_t* ctx) {
+  KK_UNUSED(ctx);
+  const kk_htable_t* ht = kk_htable_unbox(t);
+  kk_assert(slot >= 0 && slot < ht->capacity && (ht->ctrl[slot] & 0x80) == 0);
+  return kk_box_dup(ht->values[slot]);
+}
+
+kk_unit_t kk_hashtable_slot_set(kk_hashtable_t t, kk_ssize_t slot, kk_box_t value, kk_context_t* ctx) {
+  kk_htable_t* ht = kk_htable_unbox(t);
+  kk_assert(slot >= 0 && slot < ht->capacity && (ht->ctrl[slot] & 0x80) == 0);
+  kk_box_drop(ht->values[slot], ctx);
+  ht->values[slot] = value;
+  return kk_Unit;
+}
+
+kk_box_t kk_hashtable_slot_swap(kk_hashtable_t t, kk_ssize_t slot, kk_box_t value, kk_context_t* ctx) {
+  KK_UNUSED(ctx);
+  kk_htable_t* ht = kk_htable_unbox(t);
+  kk_assert(slot >= 0 && slot < ht->capacity && (ht->ctrl[slot] & 0x80) == 0);
+  const kk_box_t old = ht->values[slot];  // moved out so it can be unique
+  ht->values[slot] = value;
+  return old;
+}
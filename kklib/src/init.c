@@ -181,6 +181,10 @@ static void kklib_init(void) {
 // The thread local context; usually passed explicitly for efficiency.
 static kk_decl_thread kk_context_t* context;
 
+#ifdef KK_ALLOC_STATS
+kk_decl_thread size_t kk_alloc_count;
+#endif
+
 
 static struct { kk_block_t _block; kk_integer_t cfc; } kk_evv_empty_static = {
   { KK_HEADER_STATIC(1,KK_TAG_EVV_VECTOR) }, { ((~KUP(0))^0x02) /*==-1 smallint*/}
@@ -211,6 +215,7 @@ kk_context_t* kk_get_context(void) {
 
 void kk_free_context(void) {
   if (context != NULL) {
+    kk_async_free(context);
     kk_block_drop(context->evv, context);
     kk_basetype_free(context->kk_box_any);
     // kk_basetype_drop_assert(context->kk_box_any, KK_TAG_BOX_ANY, context);
@@ -240,6 +245,9 @@ kk_decl_export kk_context_t* kk_main_start(int argc, char** argv) {
       if (strcmp(arg, "--kktime")==0) {
         ctx->process_start = kk_timer_start();
       }
+      else if (strncmp(arg, "--kkstack=", 10)==0) {
+        // handled by `kk_main_run`
+      }
       else {
         break;
       }
@@ -487,13 +487,11 @@ static kk_string_t kk_bigint_to_string(kk_bigint_t* b, kk_context_t* ctx) {
   return str;
 }
 
-// kk_int_t to string
-static kk_string_t kk_int_to_string(kk_intx_t n, kk_context_t* ctx) {
+// kk_int_t to decimal digits in reverse order in `buf` (of at least 64 bytes); returns the number of digits.
+static kk_ssize_t kk_int_to_rbuf(kk_intx_t n, char* buf) {
   kk_assert_internal(KK_INTX_SIZE <= 26);
-  char buf[64];  // enough for 2^212
   bool neg = (n < 0);
   if (neg) n = -n;
-  // output to buf in reverse order
   kk_ssize_t i = 0;
   if (n == 0) {
     buf[i++] = '0';
@@ -506,14 +504,25 @@ static kk_string_t kk_int_to_string(kk_intx_t n, kk_context_t* ctx) {
       buf[i++] = '-';
     }
   }
+  return i;
+}
+
+// Copy the reversed digits of `buf` to `p`
+static void kk_int_rbuf_copy(const char* buf, kk_ssize_t i, char* p) {
+  for (kk_ssize_t j = 0; j < i; j++) {
+    p[j] = buf[i - j - 1];
+  }
+}
+
+// kk_int_t to string
+static kk_string_t kk_int_to_string(kk_intx_t n, kk_context_t* ctx) {
+  char buf[64];  // enough for 2^212
+  const kk_ssize_t i = kk_int_to_rbuf(n, buf);
   // write to the allocated string
   char* p;
   kk_string_t s = kk_unsafe_string_alloc_cbuf(i, &p, ctx);
-  kk_ssize_t j;
-  for (j = 0; j < i; j++) {
-    p[j] = buf[i - j - 1];
-  }
-  p[j] = 0;
+  kk_int_rbuf_copy(buf, i, p);
+  p[i] = 0;
   return s;
 }
 
@@ -1467,6 +1476,26 @@ kk_string_t kk_integer_to_string(kk_integer_t x, kk_context_t* ctx) {
   }
 }
 
+// Append the decimal representation of an integer to a string builder without allocating an intermediate string.
+kk_string_builder_t kk_string_builder_append_integer(kk_string_builder_t sb, kk_integer_t x, kk_context_t* ctx) {
+  uint8_t* p;
+  if (kk_is_smallint(x)) {
+    char buf[64];
+    const kk_ssize_t i = kk_int_to_rbuf(kk_smallint_from_integer(x), buf);
+    sb = kk_string_builder_reserve(sb, i, &p, ctx);
+    kk_int_rbuf_copy(buf, i, (char*)p);
+    return kk_string_builder_advance(sb, i);
+  }
+  else {
+    kk_bigint_t* b = kk_integer_to_bigint(x, ctx);
+    const kk_ssize_t needed = kk_bigint_to_buf_(b, NULL, 0);
+    sb = kk_string_builder_reserve(sb, needed, &p, ctx);
+    const kk_ssize_t used = kk_bigint_to_buf_(b, (char*)p, needed);
+    drop_bigint(b, ctx);
+    return kk_string_builder_advance(sb, used - 1);  // don't count the ending zero included in used
+  }
+}
+
 static kk_string_t kk_int_to_hex_string(kk_intx_t i, bool use_capitals, kk_context_t* ctx) {
   kk_assert_internal(i >= 0);
   char buf[64];
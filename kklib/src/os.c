@@ -39,6 +39,10 @@ typedef struct _stat64  kk_stat_t;
 typedef struct stat     kk_stat_t;
 #endif
 
+#if !defined(S_ISDIR) && defined(S_IFMT)
+#define S_ISDIR(m)  (((m) & S_IFMT) == S_IFDIR)
+#endif
+
 static int kk_posix_open(kk_string_t path, int flags, int create_perm, kk_file_t* f, kk_context_t* ctx) {
   *f = 0;
 #ifdef WIN32
@@ -182,6 +186,20 @@ static int kk_posix_write_retry(const kk_file_t out, const uint8_t* buf, const k
 }
 
 
+typedef struct kk_posix_write_chunk_s {
+  kk_file_t out;
+  int       err;
+} kk_posix_write_chunk_t;
+
+static bool kk_posix_write_chunk(const uint8_t* buf, kk_ssize_t len, void* arg) {
+  kk_posix_write_chunk_t* w = (kk_posix_write_chunk_t*)arg;
+  kk_ssize_t nwritten;
+  w->err = kk_posix_write_retry(w->out, buf, len, &nwritten);
+  if (w->err == 0 && nwritten < len) w->err = EIO;
+  return (w->err == 0);
+}
+
+
 /*--------------------------------------------------------------------------------------------------
   Text files
 --------------------------------------------------------------------------------------------------*/
@@ -224,20 +242,293 @@ kk_decl_export int kk_os_write_text_file(kk_string_t path, kk_string_t content,
     kk_string_drop(content, ctx);
     return err;
   }
-  err = 0;
-  kk_ssize_t len;
-  const uint8_t* buf = kk_string_buf_borrow(content, &len);
-  if (len > 0) {
-    kk_ssize_t nwritten;
-    err = kk_posix_write_retry(f, buf, len, &nwritten);
-    if (err == 0 && nwritten < len) err = EIO;
-  }
+  kk_posix_write_chunk_t w = { f, 0 };
+  kk_string_foreach_chunk_borrow(content, &kk_posix_write_chunk, &w);  // don't flatten ropes
+  err = w.err;
   kk_string_drop(content, ctx);
   kk_posix_close(f);
   return err;
 }
 
 
+/*--------------------------------------------------------------------------------------------------
+  Streaming files
+  A file handle owns a buffer of `bufsize` bytes. When reading, the buffer holds input for 
+  `kk_os_file_read_line` and the bytes of an incomplete utf-8 sequence at the end of a chunk. 
+  When writing, it holds output until it is full or the handle is flushed. 
+  This way the memory use is independent of the file size.
+--------------------------------------------------------------------------------------------------*/
+
+#define KK_OS_FILE_BUFSIZE_MIN  (64)
+
+typedef struct kk_os_file_s {
+  kk_file_t   fd;          // file descriptor (or -1 if closed)
+  bool        writable;    // opened for writing?
+  bool        eof;         // reached the end of the input?
+  kk_ssize_t  bufsize;     // size of `buf`
+  kk_ssize_t  pos;         // read position in `buf`
+  kk_ssize_t  len;         // valid bytes in `buf` (or pending output if `writable`)
+  uint8_t*    buf;
+  kk_bytes_t  chunk;       // last chunk returned by `kk_os_file_read_chunk`; reused when it is unique again
+  kk_ssize_t  line_cap;    // capacity of `line`
+  uint8_t*    line;        // scratch buffer for lines that straddle the end of `buf`
+} kk_os_file_t;
+
+static int kk_os_file_flush_buf(kk_os_file_t* f) {
+  if (!f->writable || f->len <= 0) return 0;
+  kk_ssize_t nwritten;
+  int err = kk_posix_write_retry(f->fd, f->buf, f->len, &nwritten);
+  if (err == 0 && nwritten < f->len) err = EIO;
+  f->len = 0;
+  return err;
+}
+
+static int kk_os_file_close_buf(kk_os_file_t* f, kk_context_t* ctx) {
+  if (f->fd < 0) return EBADF;
+  int err = kk_os_file_flush_buf(f);
+  int cerr = kk_posix_close(f->fd);
+  if (err == 0) err = cerr;
+  f->fd = -1;
+  f->pos = f->len = 0;
+  kk_free(f->buf);
+  f->buf = NULL;
+  kk_free(f->line);
+  f->line = NULL;
+  f->line_cap = 0;
+  kk_bytes_drop(f->chunk, ctx);
+  f->chunk = kk_bytes_empty();
+  return err;
+}
+
+static void kk_os_file_free(void* p, kk_block_t* b, kk_context_t* ctx) {
+  KK_UNUSED(b);
+  kk_os_file_t* f = (kk_os_file_t*)p;
+  if (f == NULL) return;
+  if (f->fd >= 0) kk_os_file_close_buf(f, ctx);  // errors cannot be reported at this point
+  kk_free(f);
+}
+
+static kk_os_file_t* kk_os_file_unbox_borrow(kk_box_t file) {
+  return (kk_os_file_t*)kk_cptr_raw_unbox(file);
+}
+
+kk_decl_export int kk_os_file_open(kk_string_t path, bool write, bool append, kk_ssize_t bufsize, kk_box_t* file, kk_context_t* ctx) {
+  *file = kk_box_null;
+  if (bufsize < KK_OS_FILE_BUFSIZE_MIN) bufsize = KK_OS_FILE_BUFSIZE_MIN;
+  const int flags = (!write ? O_RDONLY : (O_WRONLY | O_CREAT | (append ? O_APPEND : O_TRUNC)));
+  kk_file_t fd;
+  int err = kk_posix_open(path, flags, 0644, &fd, ctx);
+  if (err != 0) return err;
+  kk_os_file_t* f = (kk_os_file_t*)kk_malloc(kk_ssizeof(kk_os_file_t), ctx);
+  uint8_t* buf = (uint8_t*)kk_malloc(bufsize, ctx);
+  if (f == NULL || buf == NULL) {
+    kk_free(f);
+    kk_free(buf);
+    kk_posix_close(fd);
+    return ENOMEM;
+  }
+  f->fd = fd;
+  f->writable = write;
+  f->eof = false;
+  f->bufsize = bufsize;
+  f->pos = 0;
+  f->len = 0;
+  f->buf = buf;
+  f->chunk = kk_bytes_empty();
+  f->line_cap = 0;
+  f->line = NULL;
+  *file = kk_cptr_raw_box(&kk_os_file_free, f, ctx);
+  return 0;
+}
+
+// Fill the buffer with fresh input (keeping any unread bytes).
+static int kk_os_file_fill(kk_os_file_t* f) {
+  if (f->pos > 0) {
+    kk_memmove(f->buf, f->buf + f->pos, f->len - f->pos);
+    f->len -= f->pos;
+    f->pos = 0;
+  }
+  if (f->eof || f->len >= f->bufsize) return 0;
+  const kk_ssize_t todo = f->bufsize - f->len;
+  kk_ssize_t nread;
+  int err = kk_posix_read_retry(f->fd, f->buf + f->len, todo, &nread);
+  if (err != 0) return err;
+  if (nread < todo) f->eof = true;
+  f->len += nread;
+  return 0;
+}
+
+// Return the length of the prefix of `s` that does not end in an incomplete utf-8 sequence.
+static kk_ssize_t kk_utf8_complete_prefix(const uint8_t* s, kk_ssize_t len) {
+  kk_ssize_t i = len;
+  while (i > 0 && i > len - 4 && kk_utf8_is_cont(s[i-1])) { i--; }
+  if (i <= 0) return len;
+  const uint8_t c = s[i-1];
+  const kk_ssize_t n = (c < 0xC0 ? 1 : (c < 0xE0 ? 2 : (c < 0xF0 ? 3 : 4)));
+  return ((i - 1) + n > len ? i - 1 : len);
+}
+
+// Read the next chunk of at most `bufsize` bytes as a string. Returns an empty string at the end of the file.
+// The string buffer of the previous chunk is reused if the caller no longer holds a reference to it.
+kk_decl_export int kk_os_file_read_chunk(kk_box_t file, kk_string_t* chunk, kk_context_t* ctx) {
+  *chunk = kk_string_empty();
+  kk_os_file_t* f = kk_os_file_unbox_borrow(file);
+  int err = 0;
+  if (f == NULL || f->fd < 0 || f->writable) { err = EBADF; goto done; }
+
+  // reuse the previous chunk if it is unique, otherwise allocate a fresh one
+  uint8_t* cbuf;
+  if (kk_datatype_is_unique(f->chunk) && kk_datatype_has_tag(f->chunk, KK_TAG_BYTES)) {
+    cbuf = kk_datatype_as_assert(kk_bytes_normal_t, f->chunk, KK_TAG_BYTES)->buf;
+  }
+  else {
+    kk_bytes_drop(f->chunk, ctx);
+    f->chunk = kk_bytes_alloc_buf(f->bufsize, &cbuf, ctx);
+  }
+
+  // first any buffered input, then read directly into the chunk
+  // (the buffered input is only consumed once the read succeeded)
+  kk_ssize_t n = f->len - f->pos;
+  kk_memcpy(cbuf, f->buf + f->pos, n);
+  if (!f->eof && n < f->bufsize) {
+    const kk_ssize_t todo = f->bufsize - n;
+    kk_ssize_t nread;
+    err = kk_posix_read_retry(f->fd, cbuf + n, todo, &nread);
+    if (err != 0) goto done;
+    if (nread < todo) f->eof = true;
+    n += nread;
+  }
+  f->pos = f->len = 0;
+
+  // hold back an incomplete utf-8 sequence at the end for the next chunk
+  if (!f->eof) {
+    const kk_ssize_t valid = kk_utf8_complete_prefix(cbuf, n);
+    kk_memcpy(f->buf, cbuf + valid, n - valid);
+    f->len = n - valid;
+    n = valid;
+  }
+  if (n > 0) {
+    kk_bytes_normal_t b = kk_datatype_as_assert(kk_bytes_normal_t, f->chunk, KK_TAG_BYTES);
+    b->length = n;
+    b->buf[n] = 0;
+    *chunk = kk_string_convert_from_qutf8(kk_bytes_dup(f->chunk), ctx);  // returned as-is if valid
+  }
+
+done:
+  kk_box_drop(file, ctx);
+  return err;
+}
+
+// Read the next line (without the line ending). Sets `eof` to `true` if there are no more lines.
+kk_decl_export int kk_os_file_read_line(kk_box_t file, kk_string_t* line, bool* eof, kk_context_t* ctx) {
+  *line = kk_string_empty();
+  *eof = false;
+  kk_os_file_t* f = kk_os_file_unbox_borrow(file);
+  int err = 0;
+  if (f == NULL || f->fd < 0 || f->writable) { err = EBADF; goto done; }
+
+  kk_ssize_t linelen = 0;   // bytes in the scratch `line` buffer
+  bool found = false;
+  do {
+    if (f->pos >= f->len) {
+      if (f->eof) break;
+      err = kk_os_file_fill(f);
+      if (err != 0) goto done;
+      if (f->pos >= f->len) break;
+    }
+    const uint8_t* start = f->buf + f->pos;
+    const kk_ssize_t avail = f->len - f->pos;
+    const uint8_t* nl = (const uint8_t*)memchr(start, '\n', kk_to_size_t(avail));
+    const kk_ssize_t n = (nl == NULL ? avail : (nl - start));
+    found = (nl != NULL);
+    if (found && linelen == 0) {
+      // common case: the line is fully in the buffer; allocate the string directly
+      const kk_ssize_t m = (n > 0 && start[n-1] == '\r' ? n - 1 : n);
+      *line = kk_string_alloc_from_qutf8n(m, (const char*)start, ctx);
+      f->pos += n + 1;
+      goto done;
+    }
+    // otherwise append to the scratch line buffer
+    if (linelen + n > f->line_cap) {
+      kk_ssize_t newcap = (f->line_cap > 0 ? 2*f->line_cap : f->bufsize);
+      while (newcap < linelen + n) { newcap *= 2; }
+      uint8_t* newline = (uint8_t*)kk_realloc(f->line, newcap, ctx);
+      if (newline == NULL) { err = ENOMEM; goto done; }
+      f->line = newline;
+      f->line_cap = newcap;
+    }
+    kk_memcpy(f->line + linelen, start, n);
+    linelen += n;
+    f->pos += (found ? n + 1 : n);
+  } while (!found);
+
+  if (!found && linelen == 0) {
+    *eof = true;
+  }
+  else {
+    if (linelen > 0 && f->line[linelen-1] == '\r') linelen--;
+    *line = kk_string_alloc_from_qutf8n(linelen, (const char*)f->line, ctx);
+  }
+
+done:
+  kk_box_drop(file, ctx);
+  return err;
+}
+
+typedef struct kk_os_file_write_chunk_s {
+  kk_os_file_t* file;
+  int           err;
+} kk_os_file_write_chunk_t;
+
+static bool kk_os_file_write_chunk(const uint8_t* buf, kk_ssize_t len, void* arg) {
+  kk_os_file_write_chunk_t* w = (kk_os_file_write_chunk_t*)arg;
+  kk_os_file_t* f = w->file;
+  if (f->len + len > f->bufsize) {
+    w->err = kk_os_file_flush_buf(f);
+    if (w->err != 0) return false;
+  }
+  if (len >= f->bufsize) {
+    // write large chunks directly
+    kk_ssize_t nwritten;
+    w->err = kk_posix_write_retry(f->fd, buf, len, &nwritten);
+    if (w->err == 0 && nwritten < len) w->err = EIO;
+  }
+  else {
+    kk_memcpy(f->buf + f->len, buf, len);
+    f->len += len;
+  }
+  return (w->err == 0);
+}
+
+kk_decl_export int kk_os_file_write(kk_box_t file, kk_string_t s, kk_context_t* ctx) {
+  kk_os_file_t* f = kk_os_file_unbox_borrow(file);
+  kk_os_file_write_chunk_t w = { f, 0 };
+  if (f == NULL || f->fd < 0 || !f->writable) {
+    w.err = EBADF;
+  }
+  else {
+    kk_string_foreach_chunk_borrow(s, &kk_os_file_write_chunk, &w);  // don't flatten ropes
+  }
+  kk_string_drop(s, ctx);
+  kk_box_drop(file, ctx);
+  return w.err;
+}
+
+kk_decl_export int kk_os_file_flush(kk_box_t file, kk_context_t* ctx) {
+  kk_os_file_t* f = kk_os_file_unbox_borrow(file);
+  int err = (f == NULL || f->fd < 0 ? EBADF : kk_os_file_flush_buf(f));
+  kk_box_drop(file, ctx);
+  return err;
+}
+
+kk_decl_export int kk_os_file_close(kk_box_t file, kk_context_t* ctx) {
+  kk_os_file_t* f = kk_os_file_unbox_borrow(file);
+  int err = (f == NULL ? EBADF : kk_os_file_close_buf(f, ctx));
+  kk_box_drop(file, ctx);
+  return err;
+}
+
+
 
 /*--------------------------------------------------------------------------------------------------
   Directories
@@ -539,8 +830,8 @@ kk_decl_export int kk_os_list_directory(kk_string_t dir, kk_vector_t* contents,
     if (!kk_string_is_empty_borrow(name)) {
       // push name
       if (count >= len) {
-        // realloc vector
-        const kk_ssize_t newlen = (len > 1000 ? len + 1000 : 2*len);
+        // grow geometrically so large directories take amortized constant time per entry
+        const kk_ssize_t newlen = len + len/2;
         vec = kk_vector_realloc(vec, newlen, kk_integer_box(kk_integer_zero), ctx);
         len = newlen;
       }
@@ -553,44 +844,573 @@ kk_decl_export int kk_os_list_directory(kk_string_t dir, kk_vector_t* contents,
   } while (os_findnext(d, &entry, &err));
   os_findclose(d);
 
-  if(count != len) {
-    *contents = kk_vector_realloc(vec, count, kk_box_null, ctx);
-  } 
+  *contents = (count != len ? kk_vector_realloc(vec, count, kk_box_null, ctx) : vec);
   return err;
 }
 
+/*--------------------------------------------------------------------------------------------------
+  Walk directories
+  A walker lists a directory tree using a few worker threads. Each worker takes a pending 
+  directory from a shared stack, reads its entries (using `getdents64` with a large buffer on Linux),
+  and pushes the subdirectories back on the stack. The entry kind comes from `d_type` so entries
+  are only `stat`-ed on file systems that do not report it. Symbolic links are not followed.
+  The entries are collected in batches of plain UTF-8 paths that are only converted to Koka 
+  strings by the consumer in `kk_os_walk_next`; at most `KK_OS_WALK_READY_MAX` batches are
+  read ahead. On Windows the directories are read on demand by the consumer itself.
+--------------------------------------------------------------------------------------------------*/
+
+#define KK_OS_WALK_BUFSIZE    (256*1024)   // `getdents64` buffer
+#define KK_OS_WALK_BATCH      (1024)       // entries per batch
+#define KK_OS_WALK_READY_MAX  (64)         // batches read ahead
+#define KK_OS_WALK_WORKERS    (8)
+
+#if !defined(WIN32)
+#include <pthread.h>
+#if defined(__linux__)
+#include <sys/syscall.h>
+#endif
+#endif
+
+// A batch of entries, each stored as a kind ('d' for a directory, 'f' for a file, or 'o' otherwise)
+// followed by the 0 terminated path.
+typedef struct kk_os_walk_batch_s {
+  struct kk_os_walk_batch_s* next;
+  kk_ssize_t count;
+  kk_ssize_t used;
+  kk_ssize_t size;
+  char*      data;
+} kk_os_walk_batch_t;
+
+typedef struct kk_os_walk_dir_s {
+  struct kk_os_walk_dir_s* next;
+  int  depth;
+  char path[1];
+} kk_os_walk_dir_t;
+
+typedef struct kk_os_walk_s {
+  kk_os_walk_dir_t*   pending;      // stack of directories to read (depth-first keeps it small)
+  kk_os_walk_batch_t* ready;        // batches for the consumer
+  kk_os_walk_batch_t* ready_tail;
+  kk_ssize_t          ready_count;
+  int                 max_depth;
+  bool                cancel;
+#if !defined(WIN32)
+  kk_ssize_t          busy;         // workers reading a directory
+  kk_ssize_t          running;      // workers that have not exited yet
+  pthread_mutex_t     lock;
+  pthread_cond_t      has_work;     // a pending directory, or done
+  pthread_cond_t      has_batch;    // a ready batch, or all workers exited
+  pthread_cond_t      has_room;     // fewer than `KK_OS_WALK_READY_MAX` ready batches
+  kk_ssize_t          thread_count;
+  pthread_t           threads[KK_OS_WALK_WORKERS];
+  char*               bufs[KK_OS_WALK_WORKERS];
+#endif
+} kk_os_walk_t;
+
+static void kk_os_walk_batch_free(kk_os_walk_batch_t* batch) {
+  if (batch == NULL) return;
+  free(batch->data);
+  free(batch);
+}
+
+// Append an entry `dir/name` to a batch (allocated on demand).
+static bool kk_os_walk_batch_add(kk_os_walk_batch_t** pbatch, char kind, const char* dir, size_t dirlen, const char* name, size_t namelen) {
+  kk_os_walk_batch_t* batch = *pbatch;
+  if (batch == NULL) {
+    batch = (kk_os_walk_batch_t*)calloc(1, sizeof(kk_os_walk_batch_t));
+    if (batch == NULL) return false;
+    *pbatch = batch;
+  }
+  const bool sep = (dirlen > 0 && dir[dirlen-1] != '/' && dir[dirlen-1] != '\\');
+  const kk_ssize_t needed = (kk_ssize_t)(1 + dirlen + (sep ? 1 : 0) + namelen + 1);
+  if (batch->used + needed > batch->size) {
+    kk_ssize_t newsize = (batch->size == 0 ? 64*1024 : 2*batch->size);
+    while (newsize < batch->used + needed) { newsize *= 2; }
+    char* data = (char*)realloc(batch->data, (size_t)newsize);
+    if (data == NULL) return false;
+    batch->data = data;
+    batch->size = newsize;
+  }
+  char* p = batch->data + batch->used;
+  *p++ = kind;
+  memcpy(p, dir, dirlen); p += dirlen;
+  if (sep) { *p++ = '/'; }
+  memcpy(p, name, namelen); p += namelen;
+  *p = 0;
+  batch->used += needed;
+  batch->count++;
+  return true;
+}
+
+static kk_os_walk_dir_t* kk_os_walk_dir_alloc(const char* dir, size_t dirlen, const char* name, size_t namelen, int depth) {
+  const bool sep = (namelen > 0 && dirlen > 0 && dir[dirlen-1] != '/' && dir[dirlen-1] != '\\');
+  kk_os_walk_dir_t* d = (kk_os_walk_dir_t*)malloc(sizeof(kk_os_walk_dir_t) + dirlen + 1 + namelen);
+  if (d == NULL) return NULL;
+  d->next = NULL;
+  d->depth = depth;
+  char* p = d->path;
+  memcpy(p, dir, dirlen); p += dirlen;
+  if (sep) { *p++ = '/'; }
+  memcpy(p, name, namelen); p += namelen;
+  *p = 0;
+  return d;
+}
+
+static void kk_os_walk_enqueue_ready(kk_os_walk_t* w, kk_os_walk_batch_t* batch) {
+  batch->next = NULL;
+  if (w->ready_tail == NULL) { w->ready = batch; }
+                        else { w->ready_tail->next = batch; }
+  w->ready_tail = batch;
+  w->ready_count++;
+}
+
+static kk_os_walk_batch_t* kk_os_walk_dequeue_ready(kk_os_walk_t* w) {
+  kk_os_walk_batch_t* batch = w->ready;
+  if (batch != NULL) {
+    w->ready = batch->next;
+    if (w->ready == NULL) { w->ready_tail = NULL; }
+    w->ready_count--;
+  }
+  return batch;
+}
+
+#if !defined(WIN32)
+// Hand a batch to the consumer; called with the lock held. Returns `false` if the walk was cancelled.
+static bool kk_os_walk_ready_locked(kk_os_walk_t* w, kk_os_walk_batch_t* batch) {
+  while (w->ready_count >= KK_OS_WALK_READY_MAX && !w->cancel) {
+    pthread_cond_wait(&w->has_room, &w->lock);
+  }
+  if (w->cancel) {
+    kk_os_walk_batch_free(batch);
+    return false;
+  }
+  kk_os_walk_enqueue_ready(w, batch);
+  pthread_cond_signal(&w->has_batch);
+  return true;
+}
+
+static bool kk_os_walk_flush(kk_os_walk_t* w, kk_os_walk_batch_t** pbatch) {
+  pthread_mutex_lock(&w->lock);
+  const bool ok = kk_os_walk_ready_locked(w, *pbatch);
+  pthread_mutex_unlock(&w->lock);
+  *pbatch = NULL;
+  return ok;
+}
+
+static void kk_os_walk_schedule(kk_os_walk_t* w, kk_os_walk_dir_t* first, kk_os_walk_dir_t* last) {
+  pthread_mutex_lock(&w->lock);
+  last->next = w->pending;
+  w->pending = first;
+  pthread_mutex_unlock(&w->lock);
+  pthread_cond_broadcast(&w->has_work);
+}
+#else
+static bool kk_os_walk_flush(kk_os_walk_t* w, kk_os_walk_batch_t** pbatch) {
+  kk_os_walk_enqueue_ready(w, *pbatch);
+  *pbatch = NULL;
+  return true;
+}
+
+static void kk_os_walk_schedule(kk_os_walk_t* w, kk_os_walk_dir_t* first, kk_os_walk_dir_t* last) {
+  last->next = w->pending;
+  w->pending = first;
+}
+#endif
+
+// Add an entry of directory `dir` to the current batch; subdirectories are added to the `subs` list.
+// Returns `false` if the walk should stop.
+static bool kk_os_walk_entry(kk_os_walk_t* w, kk_os_walk_dir_t* dir, size_t dirlen, const char* name, char kind,
+                             kk_os_walk_batch_t** pbatch, kk_os_walk_dir_t** subs, kk_os_walk_dir_t** subs_last) {
+  const size_t namelen = strlen(name);
+  if (name[0] == '.' && (namelen == 1 || (namelen == 2 && name[1] == '.'))) return true;
+  if (kind == 'd' && dir->depth < w->max_depth) {
+    kk_os_walk_dir_t* sub = kk_os_walk_dir_alloc(dir->path, dirlen, name, namelen, dir->depth + 1);
+    if (sub != NULL) {
+      sub->next = *subs;
+      if (*subs == NULL) { *subs_last = sub; }
+      *subs = sub;
+    }
+  }
+  if (!kk_os_walk_batch_add(pbatch, kind, dir->path, dirlen, name, namelen)) return false;
+  if ((*pbatch)->count >= KK_OS_WALK_BATCH) return kk_os_walk_flush(w, pbatch);
+  return true;
+}
+
+#if !defined(WIN32)
+static char kk_os_walk_kind(int dirfd, const char* name, unsigned char dtype) {
+  #if defined(DT_DIR)
+  if (dtype == DT_DIR) return 'd';
+  if (dtype == DT_REG) return 'f';
+  if (dtype != DT_UNKNOWN) return 'o';
+  #else
+  KK_UNUSED(dtype);
+  #endif
+  struct stat st;
+  if (fstatat(dirfd, name, &st, AT_SYMLINK_NOFOLLOW) != 0) return 'o';
+  if (S_ISDIR(st.st_mode)) return 'd';
+  if (S_ISREG(st.st_mode)) return 'f';
+  return 'o';
+}
+
+#if defined(__linux__) && defined(SYS_getdents64)
+typedef struct kk_linux_dirent64_s {
+  uint64_t       d_ino;
+  int64_t        d_off;
+  unsigned short d_reclen;
+  unsigned char  d_type;
+  char           d_name[];
+} kk_linux_dirent64_t;
+#endif
+
+// Read a directory; unreadable directories are skipped.
+static bool kk_os_walk_read(kk_os_walk_t* w, kk_os_walk_dir_t* dir, kk_os_walk_batch_t** pbatch, char* buf, kk_context_t* ctx) {
+  KK_UNUSED(ctx);
+  const size_t dirlen = strlen(dir->path);
+  kk_os_walk_dir_t* subs = NULL;
+  kk_os_walk_dir_t* subs_last = NULL;
+  bool ok = true;
+  #if defined(__linux__) && defined(SYS_getdents64)
+  const int fd = open(dir->path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+  if (fd < 0) return true;
+  long n;
+  while (ok && (n = syscall(SYS_getdents64, fd, buf, KK_OS_WALK_BUFSIZE)) > 0) {
+    for (long pos = 0; ok && pos < n; ) {
+      kk_linux_dirent64_t* entry = (kk_linux_dirent64_t*)(buf + pos);
+      pos += entry->d_reclen;
+      ok = kk_os_walk_entry(w, dir, dirlen, entry->d_name, kk_os_walk_kind(fd, entry->d_name, entry->d_type), pbatch, &subs, &subs_last);
+    }
+  }
+  close(fd);
+  #else
+  KK_UNUSED(buf);
+  DIR* d = opendir(dir->path);
+  if (d == NULL) return true;
+  struct dirent* entry;
+  while (ok && (entry = readdir(d)) != NULL) {
+    #if defined(DT_DIR)
+    const unsigned char dtype = entry->d_type;
+    #else
+    const unsigned char dtype = 0;
+    #endif
+    ok = kk_os_walk_entry(w, dir, dirlen, entry->d_name, kk_os_walk_kind(dirfd(d), entry->d_name, dtype), pbatch, &subs, &subs_last);
+  }
+  closedir(d);
+  #endif
+  if (subs != NULL) kk_os_walk_schedule(w, subs, subs_last);
+  return ok;
+}
+
+static void* kk_os_walk_worker(void* varg) {
+  kk_os_walk_t* w = (kk_os_walk_t*)varg;
+  kk_os_walk_batch_t* batch = NULL;
+  char* buf = NULL;
+  pthread_mutex_lock(&w->lock);
+  for (kk_ssize_t i = 0; i < w->thread_count; i++) {
+    if (pthread_equal(w->threads[i], pthread_self())) { buf = w->bufs[i]; break; }
+  }
+  while (!w->cancel) {
+    kk_os_walk_dir_t* dir = w->pending;
+    if (dir == NULL) {
+      if (batch != NULL) {
+        // hand over our entries before waiting for more work
+        kk_os_walk_ready_locked(w, batch);
+        batch = NULL;
+      }
+      else if (w->busy == 0) {
+        break;  // all directories are read
+      }
+      else {
+        pthread_cond_wait(&w->has_work, &w->lock);
+      }
+      continue;
+    }
+    w->pending = dir->next;
+    w->busy++;
+    pthread_mutex_unlock(&w->lock);
+    kk_os_walk_read(w, dir, &batch, buf, NULL);
+    free(dir);
+    pthread_mutex_lock(&w->lock);
+    w->busy--;
+  }
+  w->running--;
+  pthread_mutex_unlock(&w->lock);
+  pthread_cond_broadcast(&w->has_work);
+  pthread_cond_broadcast(&w->has_batch);
+  kk_os_walk_batch_free(batch);
+  return NULL;
+}
+
+#else
+static bool kk_os_walk_read(kk_os_walk_t* w, kk_os_walk_dir_t* dir, kk_os_walk_batch_t** pbatch, char* buf, kk_context_t* ctx) {
+  KK_UNUSED(buf);
+  const size_t dirlen = strlen(dir->path);
+  kk_os_walk_dir_t* subs = NULL;
+  kk_os_walk_dir_t* subs_last = NULL;
+  dir_cursor d = 0;
+  dir_entry entry;
+  int err;
+  bool ok = os_findfirst(kk_string_alloc_from_qutf8(dir->path, ctx), &d, &entry, &err, ctx);
+  if (!ok) return true;
+  do {
+    const char kind = ((entry.attrib & _A_SUBDIR) != 0 ? 'd' : 'f');
+    kk_string_t name = os_direntry_name(&entry, ctx);
+    if (!kk_string_is_empty_borrow(name)) {
+      const char* s = kk_string_cbuf_borrow(name, NULL);
+      ok = kk_os_walk_entry(w, dir, dirlen, s, kind, pbatch, &subs, &subs_last);
+    }
+    kk_string_drop(name, ctx);
+  } while (ok && os_findnext(d, &entry, &err));
+  os_findclose(d);
+  if (subs != NULL) kk_os_walk_schedule(w, subs, subs_last);
+  return ok;
+}
+#endif
+
+static void kk_os_walk_free(void* p, kk_block_t* b, kk_context_t* ctx) {
+  KK_UNUSED(b); KK_UNUSED(ctx);
+  kk_os_walk_t* w = (kk_os_walk_t*)p;
+  #if !defined(WIN32)
+  pthread_mutex_lock(&w->lock);
+  w->cancel = true;
+  pthread_mutex_unlock(&w->lock);
+  pthread_cond_broadcast(&w->has_work);
+  pthread_cond_broadcast(&w->has_room);
+  for (kk_ssize_t i = 0; i < w->thread_count; i++) {
+    pthread_join(w->threads[i], NULL);
+    free(w->bufs[i]);
+  }
+  pthread_cond_destroy(&w->has_room);
+  pthread_cond_destroy(&w->has_batch);
+  pthread_cond_destroy(&w->has_work);
+  pthread_mutex_destroy(&w->lock);
+  #endif
+  while (w->pending != NULL) {
+    kk_os_walk_dir_t* next = w->pending->next;
+    free(w->pending);
+    w->pending = next;
+  }
+  kk_os_walk_batch_t* batch;
+  while ((batch = kk_os_walk_dequeue_ready(w)) != NULL) {
+    kk_os_walk_batch_free(batch);
+  }
+  free(w);
+}
+
+kk_decl_export int kk_os_walk_open(kk_string_t dir, int max_depth, kk_box_t* walker, kk_context_t* ctx) {
+  *walker = kk_box_null;
+  kk_stat_t st = { 0 };
+  int err = kk_posix_stat(dir, &st, ctx);
+  if (err == 0 && !S_ISDIR(st.st_mode)) err = ENOTDIR;
+  kk_os_walk_dir_t* root = NULL;
+  if (err == 0) {
+    kk_ssize_t len;
+    const uint8_t* s = kk_string_buf_borrow(dir, &len);
+    root = kk_os_walk_dir_alloc((const char*)s, (size_t)len, "", 0, 0);
+    if (root == NULL) err = ENOMEM;
+  }
+  kk_string_drop(dir, ctx);
+  if (err != 0) return err;
+
+  kk_os_walk_t* w = (kk_os_walk_t*)calloc(1, sizeof(kk_os_walk_t));
+  if (w == NULL) { free(root); return ENOMEM; }
+  w->max_depth = max_depth;
+  w->pending = root;
+  #if !defined(WIN32)
+  pthread_mutex_init(&w->lock, NULL);
+  pthread_cond_init(&w->has_work, NULL);
+  pthread_cond_init(&w->has_batch, NULL);
+  pthread_cond_init(&w->has_room, NULL);
+  kk_ssize_t n = kk_cpu_count(ctx);
+  if (n > KK_OS_WALK_WORKERS) n = KK_OS_WALK_WORKERS;
+  if (n < 1) n = 1;
+  pthread_mutex_lock(&w->lock);  // the workers find their buffer once `thread_count` is final
+  for (kk_ssize_t i = 0; i < n; i++) {
+    w->bufs[i] = (char*)malloc(KK_OS_WALK_BUFSIZE);
+    if (w->bufs[i] == NULL) break;
+    if (pthread_create(&w->threads[i], NULL, &kk_os_walk_worker, w) != 0) {
+      free(w->bufs[i]);
+      break;
+    }
+    w->thread_count++;
+    w->running++;
+  }
+  pthread_mutex_unlock(&w->lock);
+  if (w->thread_count == 0) {
+    kk_os_walk_free(w, NULL, ctx);
+    return EAGAIN;
+  }
+  #endif
+  *walker = kk_cptr_raw_box(&kk_os_walk_free, w, ctx);
+  return 0;
+}
+
+kk_decl_export int kk_os_walk_next(kk_box_t walker, kk_vector_t* paths, kk_string_t* kinds, kk_context_t* ctx) {
+  kk_os_walk_t* w = (kk_os_walk_t*)kk_cptr_raw_unbox(walker);
+  kk_os_walk_batch_t* batch = NULL;
+  int err = 0;
+  #if !defined(WIN32)
+  pthread_mutex_lock(&w->lock);
+  while (w->ready == NULL && w->running > 0) {
+    pthread_cond_wait(&w->has_batch, &w->lock);
+  }
+  batch = kk_os_walk_dequeue_ready(w);
+  pthread_mutex_unlock(&w->lock);
+  pthread_cond_signal(&w->has_room);
+  #else
+  kk_os_walk_batch_t* current = NULL;
+  while (w->ready == NULL && w->pending != NULL) {
+    kk_os_walk_dir_t* dir = w->pending;
+    w->pending = dir->next;
+    const bool ok = kk_os_walk_read(w, dir, &current, NULL, ctx);
+    free(dir);
+    if (!ok) { err = ENOMEM; break; }
+    if (w->pending == NULL && current != NULL) kk_os_walk_flush(w, &current);
+  }
+  if (current != NULL) kk_os_walk_flush(w, &current);
+  batch = kk_os_walk_dequeue_ready(w);
+  #endif
+  kk_box_drop(walker, ctx);
+  if (batch == NULL) {
+    *paths = kk_vector_empty();
+    *kinds = kk_string_empty();
+    return err;
+  }
+  char* kbuf;
+  *kinds = kk_unsafe_string_alloc_cbuf(batch->count, &kbuf, ctx);
+  kk_box_t* pbuf;
+  *paths = kk_vector_alloc_uninit(batch->count, &pbuf, ctx);
+  const char* p = batch->data;
+  for (kk_ssize_t i = 0; i < batch->count; i++) {
+    kbuf[i] = *p++;
+    const size_t len = strlen(p);
+    pbuf[i] = kk_string_box(kk_string_alloc_from_qutf8n((kk_ssize_t)len, p, ctx));
+    p += len + 1;
+  }
+  kk_os_walk_batch_free(batch);
+  return 0;
+}
+
 
 /*--------------------------------------------------------------------------------------------------
   Run system command
+  On posix systems a command runs in `/bin/sh -c` through `posix_spawn` with pipes for its
+  standard streams. Output is read in large blocks (into a buffer that grows geometrically
+  when the whole output is returned).
 --------------------------------------------------------------------------------------------------*/
 
+#define KK_OS_PROCESS_BUFSIZE  (64*1024)
+
+#if !defined(WIN32)
+#include <spawn.h>
+#include <poll.h>
+#include <signal.h>
+#include <pthread.h>
+#include <sys/wait.h>
+extern char** environ;
+
+static int kk_posix_pipe(int fds[2]) {
+  if (pipe(fds) != 0) return errno;
+  fcntl(fds[0], F_SETFD, FD_CLOEXEC);
+  fcntl(fds[1], F_SETFD, FD_CLOEXEC);
+  return 0;
+}
+
+static void kk_posix_close_fd(int* fd) {
+  if (*fd >= 0) { close(*fd); *fd = -1; }
+}
+
+// Spawn `/bin/sh -c cmd`. For each of `in`, `out`, and `err` that is not `NULL`, the
+// standard stream of the child is connected to a pipe and our end is returned (the others are inherited).
+static int kk_posix_spawn_shell(kk_string_t cmd, int* in, int* out, int* err, pid_t* pid, kk_context_t* ctx) {
+  int pipes[3][2] = { {-1,-1}, {-1,-1}, {-1,-1} };
+  int* ends[3] = { in, out, err };
+  int res = 0;
+  for (int i = 0; i < 3 && res == 0; i++) {
+    if (ends[i] != NULL) res = kk_posix_pipe(pipes[i]);
+  }
+  posix_spawn_file_actions_t actions;
+  if (res == 0) res = posix_spawn_file_actions_init(&actions);
+  if (res == 0) {
+    for (int i = 0; i < 3 && res == 0; i++) {
+      if (ends[i] != NULL) res = posix_spawn_file_actions_adddup2(&actions, pipes[i][i == 0 ? 0 : 1], i);  // the dup clears close-on-exec
+    }
+    if (res == 0) {
+      kk_with_string_as_qutf8_borrow(cmd, ccmd, ctx) {
+        char* argv[4] = { (char*)"sh", (char*)"-c", (char*)ccmd, NULL };
+        res = posix_spawn(pid, "/bin/sh", &actions, NULL, argv, environ);
+      }
+    }
+    posix_spawn_file_actions_destroy(&actions);
+  }
+  kk_string_drop(cmd, ctx);
+  for (int i = 0; i < 3; i++) {
+    if (ends[i] == NULL) continue;
+    const int ours = (i == 0 ? 1 : 0);
+    kk_posix_close_fd(&pipes[i][1 - ours]);
+    if (res == 0) { *ends[i] = pipes[i][ours]; }
+             else { kk_posix_close_fd(&pipes[i][ours]); *ends[i] = -1; }
+  }
+  return res;
+}
+
+static int kk_posix_wait_exit(pid_t pid, int* exitcode) {
+  int status = 0;
+  while (waitpid(pid, &status, 0) < 0) {
+    if (errno != EINTR) return errno;
+  }
+  *exitcode = (WIFEXITED(status) ? WEXITSTATUS(status) : (WIFSIGNALED(status) ? 128 + WTERMSIG(status) : -1));
+  return 0;
+}
+#endif
+
 kk_decl_export int kk_os_run_command(kk_string_t cmd, kk_string_t* output, kk_context_t* ctx) {
-  FILE* f = NULL;
+  *output = kk_string_empty();
 #if defined(WIN32)
+  FILE* f = NULL;
   kk_with_string_as_qutf16w_borrow(cmd, wcmd, ctx) {
     f = _wpopen(wcmd, L"rt"); // todo: maybe open as binary?
   }
-#else
-  kk_with_string_as_qutf8_borrow(cmd, ccmd, ctx) {
-    f = popen(ccmd, "r");
-  }
-#endif
   kk_string_drop(cmd, ctx);
   if (f == NULL) return errno;
-  kk_string_t out = kk_string_empty();
-  char buf[1025];
-  while (fgets(buf, 1024, f) != NULL) {
-    buf[1024] = 0; // paranoia
-    out = kk_string_cat(out, kk_string_alloc_from_qutf8(buf,ctx), ctx);  // todo: avoid allocation
+#else
+  int fd = -1;
+  pid_t pid;
+  int err = kk_posix_spawn_shell(cmd, NULL, &fd, NULL, &pid, ctx);
+  if (err != 0) return err;
+#endif
+  kk_ssize_t cap = KK_OS_PROCESS_BUFSIZE;
+  kk_ssize_t len = 0;
+  uint8_t* buf = (uint8_t*)kk_malloc(cap, ctx);
+  int rerr = (buf == NULL ? ENOMEM : 0);
+  while (rerr == 0) {
+    if (len == cap) {
+      uint8_t* newbuf = (uint8_t*)kk_realloc(buf, 2*cap, ctx);
+      if (newbuf == NULL) { rerr = ENOMEM; break; }
+      buf = newbuf;
+      cap = 2*cap;
+    }
+#if defined(WIN32)
+    const size_t n = fread(buf + len, 1, (size_t)(cap - len), f);
+    if (n == 0) { if (ferror(f)) rerr = EIO; break; }
+#else
+    kk_ssize_t n;
+    rerr = kk_posix_read_retry(fd, buf + len, cap - len, &n);
+    if (rerr != 0 || n == 0) break;
+#endif
+    len += (kk_ssize_t)n;
   }
-  if (feof(f)) errno = 0;
 #if defined(WIN32)
   _pclose(f);
 #else
-  pclose(f);
+  close(fd);
+  int exitcode;
+  kk_posix_wait_exit(pid, &exitcode);
 #endif
-  *output = out;
-  return errno;
+  if (rerr == 0 && len > 0) {
+    *output = kk_string_alloc_from_qutf8n(len, (const char*)buf, ctx);
+  }
+  kk_free(buf);
+  return rerr;
 }
 
 kk_decl_export int kk_os_run_system(kk_string_t cmd, kk_context_t* ctx) {
@@ -609,6 +1429,283 @@ kk_decl_export int kk_os_run_system(kk_string_t cmd, kk_context_t* ctx) {
 }
 
 
+/*--------------------------------------------------------------------------------------------------
+  Streaming processes
+  `kk_os_process_next` multiplexes the pipes of a child process with `poll`: it writes pending
+  input without blocking, and reads a ready output pipe with a single `read` that returns
+  whatever is available. We therefore never block on one pipe while the child is blocked on
+  another (a full standard error while we read its standard output, or a full standard output
+  while we write its input). Input is only requested once the previous input is written.
+--------------------------------------------------------------------------------------------------*/
+
+#if !defined(WIN32)
+
+typedef struct kk_os_process_s {
+  pid_t        pid;
+  bool         reaped;
+  int          exitcode;
+  int          in;              // our end of the standard input of the child (or -1)
+  int          out[2];          // our ends of its standard output and error (or -1)
+  bool         in_requested;    // was input requested and not yet written?
+  kk_string_t  input;           // pending input
+  kk_ssize_t   input_pos;
+  uint8_t      carry[2][4];     // incomplete utf-8 sequence at the end of the previous chunk
+  kk_ssize_t   carry_len[2];
+  kk_string_t  chunk;           // last chunk returned by `kk_os_process_next`
+  uint8_t*     buf;
+} kk_os_process_t;
+
+static void kk_os_process_close_pipes(kk_os_process_t* p, kk_context_t* ctx) {
+  kk_posix_close_fd(&p->in);
+  kk_posix_close_fd(&p->out[0]);
+  kk_posix_close_fd(&p->out[1]);
+  kk_string_drop(p->input, ctx);
+  p->input = kk_string_empty();
+  p->input_pos = 0;
+}
+
+static void kk_os_process_free(void* vp, kk_block_t* b, kk_context_t* ctx) {
+  KK_UNUSED(b);
+  kk_os_process_t* p = (kk_os_process_t*)vp;
+  if (p == NULL) return;
+  kk_os_process_close_pipes(p, ctx);
+  if (!p->reaped) {
+    int status;
+    waitpid(p->pid, &status, WNOHANG);  // do not block; a running child is not reaped
+  }
+  kk_string_drop(p->chunk, ctx);
+  kk_free(p->buf);
+  kk_free(p);
+}
+
+static kk_os_process_t* kk_os_process_unbox_borrow(kk_box_t proc) {
+  return (kk_os_process_t*)kk_cptr_raw_unbox(proc);
+}
+
+// Write pending input without blocking. If the child closed its input, the rest of the input is discarded.
+static int kk_os_process_write_input(kk_os_process_t* p, kk_context_t* ctx) {
+  kk_ssize_t len;
+  const uint8_t* s = kk_string_buf_borrow(p->input, &len);
+  // block SIGPIPE so a child that exits early results in `EPIPE` instead of terminating us
+  sigset_t pipeset, oldset;
+  sigemptyset(&pipeset);
+  sigaddset(&pipeset, SIGPIPE);
+  pthread_sigmask(SIG_BLOCK, &pipeset, &oldset);
+  int err = 0;
+  while (p->input_pos < len) {
+    const ssize_t n = write(p->in, s + p->input_pos, (size_t)(len - p->input_pos));
+    if (n < 0) {
+      if (errno == EINTR) continue;
+      if (errno != EAGAIN && errno != EWOULDBLOCK) err = errno;
+      break;
+    }
+    p->input_pos += n;
+  }
+  if (err == EPIPE) {
+    sigset_t pending;
+    sigpending(&pending);
+    if (sigismember(&pending, SIGPIPE)) { int sig; sigwait(&pipeset, &sig); }
+  }
+  pthread_sigmask(SIG_SETMASK, &oldset, NULL);
+  if (err != 0 || p->input_pos >= len) {
+    kk_string_drop(p->input, ctx);
+    p->input = kk_string_empty();
+    p->input_pos = 0;
+  }
+  if (err == EPIPE) {   // the child no longer reads its input
+    kk_posix_close_fd(&p->in);
+    err = 0;
+  }
+  return err;
+}
+
+// Read from output stream `i` (0: stdout, 1: stderr). Sets `chunk` (empty at the end of the stream).
+static int kk_os_process_read(kk_os_process_t* p, int i, kk_string_t* chunk, kk_context_t* ctx) {
+  *chunk = kk_string_empty();
+  const kk_ssize_t carry = p->carry_len[i];
+  kk_memcpy(p->buf, p->carry[i], carry);
+  // a single read (see the comment above); only retry when interrupted
+  ssize_t n;
+  do {
+    n = read(p->out[i], p->buf + carry, KK_OS_PROCESS_BUFSIZE);
+  } while (n < 0 && errno == EINTR);
+  if (n < 0) return errno;
+  if (n == 0) {
+    // end of stream: return an incomplete utf-8 sequence as is (it is replaced when decoded)
+    kk_posix_close_fd(&p->out[i]);
+    p->carry_len[i] = 0;
+    if (carry > 0) *chunk = kk_string_alloc_from_qutf8n(carry, (const char*)p->buf, ctx);
+    return 0;
+  }
+  n += carry;
+  const kk_ssize_t valid = kk_utf8_complete_prefix(p->buf, n);
+  p->carry_len[i] = n - valid;
+  kk_memcpy(p->carry[i], p->buf + valid, n - valid);
+  if (valid > 0) *chunk = kk_string_alloc_from_qutf8n(valid, (const char*)p->buf, ctx);
+  return 0;
+}
+
+#endif
+
+kk_decl_export int kk_os_process_spawn(kk_string_t cmd, bool pipe_stdin, bool pipe_stderr, kk_box_t* proc, kk_context_t* ctx) {
+  *proc = kk_box_null;
+#if defined(WIN32)
+  KK_UNUSED(pipe_stdin); KK_UNUSED(pipe_stderr);
+  kk_string_drop(cmd, ctx);
+  return ENOSYS;
+#else
+  kk_os_process_t* p = (kk_os_process_t*)kk_zalloc(kk_ssizeof(kk_os_process_t), ctx);
+  uint8_t* buf = (uint8_t*)kk_malloc(KK_OS_PROCESS_BUFSIZE + 4, ctx);
+  if (p == NULL || buf == NULL) {
+    kk_free(p);
+    kk_free(buf);
+    kk_string_drop(cmd, ctx);
+    return ENOMEM;
+  }
+  p->in = p->out[0] = p->out[1] = -1;
+  p->input = kk_string_empty();
+  p->chunk = kk_string_empty();
+  p->buf = buf;
+  int err = kk_posix_spawn_shell(cmd, (pipe_stdin ? &p->in : NULL), &p->out[0], (pipe_stderr ? &p->out[1] : NULL), &p->pid, ctx);
+  if (err != 0) {
+    kk_free(buf);
+    kk_free(p);
+    return err;
+  }
+  if (p->in >= 0) fcntl(p->in, F_SETFL, fcntl(p->in, F_GETFL) | O_NONBLOCK);
+  *proc = kk_cptr_raw_box(&kk_os_process_free, p, ctx);
+  return 0;
+#endif
+}
+
+// Wait for the next event: returns `KK_OS_PROCESS_STDOUT` or `KK_OS_PROCESS_STDERR` with a non-empty chunk
+// (see `kk_os_process_chunk`), `KK_OS_PROCESS_STDIN` if the child can take more input (see `kk_os_process_write`),
+// or `KK_OS_PROCESS_DONE` once its output streams are closed.
+kk_decl_export int kk_os_process_next(kk_box_t proc, int* event, kk_context_t* ctx) {
+  *event = KK_OS_PROCESS_DONE;
+#if defined(WIN32)
+  kk_box_drop(proc, ctx);
+  return ENOSYS;
+#else
+  kk_os_process_t* p = kk_os_process_unbox_borrow(proc);
+  int err = 0;
+  while (err == 0) {
+    const bool has_input = (kk_string_len_borrow(p->input) > p->input_pos);
+    if (p->in >= 0 && !has_input && !p->in_requested) {
+      p->in_requested = true;
+      *event = KK_OS_PROCESS_STDIN;
+      break;
+    }
+    struct pollfd fds[3];
+    int ids[3];
+    int nfds = 0;
+    for (int i = 0; i < 2; i++) {
+      if (p->out[i] < 0) continue;
+      fds[nfds].fd = p->out[i]; fds[nfds].events = POLLIN; fds[nfds].revents = 0;
+      ids[nfds++] = i;
+    }
+    if (p->in >= 0 && has_input) {
+      fds[nfds].fd = p->in; fds[nfds].events = POLLOUT; fds[nfds].revents = 0;
+      ids[nfds++] = 2;
+    }
+    if (nfds == 0) break;  // done
+    if (poll(fds, (nfds_t)nfds, -1) < 0) {
+      if (errno != EINTR) err = errno;
+      continue;
+    }
+    int ready = -1;
+    for (int j = 0; j < nfds && err == 0; j++) {
+      if (fds[j].revents == 0) continue;
+      if (ids[j] == 2) {
+        err = kk_os_process_write_input(p, ctx);
+        if (kk_string_len_borrow(p->input) == 0) p->in_requested = false;
+      }
+      else if (ready < 0) {
+        ready = ids[j];
+      }
+    }
+    if (err == 0 && ready >= 0) {
+      kk_string_t chunk;
+      err = kk_os_process_read(p, ready, &chunk, ctx);
+      if (err == 0 && !kk_string_is_empty_borrow(chunk)) {
+        kk_string_drop(p->chunk, ctx);
+        p->chunk = chunk;
+        *event = (ready == 0 ? KK_OS_PROCESS_STDOUT : KK_OS_PROCESS_STDERR);
+        break;
+      }
+      kk_string_drop(chunk, ctx);
+    }
+  }
+  kk_box_drop(proc, ctx);
+  return err;
+#endif
+}
+
+// The chunk of the last `KK_OS_PROCESS_STDOUT` or `KK_OS_PROCESS_STDERR` event.
+kk_decl_export kk_string_t kk_os_process_chunk(kk_box_t proc, kk_context_t* ctx) {
+  kk_string_t chunk = kk_string_empty();
+#if !defined(WIN32)
+  kk_os_process_t* p = kk_os_process_unbox_borrow(proc);
+  chunk = p->chunk;
+  p->chunk = kk_string_empty();
+#endif
+  kk_box_drop(proc, ctx);
+  return chunk;
+}
+
+// Give input to the child; it is written by `kk_os_process_next`. An empty string closes its input.
+kk_decl_export int kk_os_process_write(kk_box_t proc, kk_string_t s, kk_context_t* ctx) {
+  int err = 0;
+#if defined(WIN32)
+  kk_string_drop(s, ctx);
+  err = ENOSYS;
+#else
+  kk_os_process_t* p = kk_os_process_unbox_borrow(proc);
+  p->in_requested = false;
+  if (kk_string_is_empty_borrow(s)) {
+    kk_string_drop(s, ctx);
+    kk_string_drop(p->input, ctx);
+    p->input = kk_string_empty();
+    p->input_pos = 0;
+    kk_posix_close_fd(&p->in);
+  }
+  else if (p->in < 0) {
+    kk_string_drop(s, ctx);   // the child no longer reads input
+  }
+  else if (kk_string_len_borrow(p->input) > p->input_pos) {
+    p->input = kk_string_cat(p->input, s, ctx);
+  }
+  else {
+    kk_string_drop(p->input, ctx);
+    p->input = s;
+    p->input_pos = 0;
+    err = kk_os_process_write_input(p, ctx);
+  }
+#endif
+  kk_box_drop(proc, ctx);
+  return err;
+}
+
+// Close the pipes and wait for the child to exit.
+kk_decl_export int kk_os_process_wait(kk_box_t proc, int* exitcode, kk_context_t* ctx) {
+  *exitcode = -1;
+  int err = 0;
+#if defined(WIN32)
+  err = ENOSYS;
+#else
+  kk_os_process_t* p = kk_os_process_unbox_borrow(proc);
+  kk_os_process_close_pipes(p, ctx);
+  if (!p->reaped) {
+    err = kk_posix_wait_exit(p->pid, &p->exitcode);
+    p->reaped = (err == 0);
+  }
+  *exitcode = p->exitcode;
+#endif
+  kk_box_drop(proc, ctx);
+  return err;
+}
+
+
 
 /*--------------------------------------------------------------------------------------------------
   Args
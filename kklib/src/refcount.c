@@ -16,6 +16,9 @@ static void kk_block_free_raw(kk_block_t* b, kk_context_t* ctx) {
   if (raw->free != NULL) {
     (*raw->free)(raw->cptr, b, ctx);
   }
+  if (kk_block_tag(b) == KK_TAG_BYTES_RAW) {
+    kk_bytes_raw_free_flat(b, ctx);
+  }
 }
 
 // Free a block and recursively decrement reference counts on children.
@@ -81,7 +84,7 @@ kk_decl_noinline void kk_block_check_drop(kk_block_t* b, uint32_t rc0, kk_contex
   }
   else {
     const uint32_t rc = kk_atomic_decr(b);
-    if (rc == RC_SHARED && b->header.thread_shared) {  // with a shared reference dropping to RC_SHARED means no more references
+    if (rc == RC_SHARED+1 && b->header.thread_shared) {  // with a shared reference dropping to RC_SHARED means no more references
       b->header.refcount = 0;        // no longer shared
       b->header.thread_shared = 0;
       kk_block_drop_free(b, ctx);            // no more references, free it.
@@ -124,7 +127,7 @@ kk_decl_noinline void kk_block_check_decref(kk_block_t* b, uint32_t rc0, kk_cont
   }
   else {
     const uint32_t rc = kk_atomic_decr(b);
-    if (rc == RC_SHARED && b->header.thread_shared) {  // with a shared reference dropping to RC_SHARED means no more references
+    if (rc == RC_SHARED+1 && b->header.thread_shared) {  // with a shared reference dropping to RC_SHARED means no more references
       b->header.refcount = 0;        // no longer shared
       b->header.thread_shared = 0;
       kk_free(b);               // no more references, free it.
@@ -156,7 +159,7 @@ kk_decl_noinline kk_block_t* kk_block_check_dup(kk_block_t* b, uint32_t rc0) {
 // Decrement a shared refcount without freeing the block yet. Returns true if there are no more references.
 static bool block_check_decref_no_free(kk_block_t* b) {
   const uint32_t rc = kk_atomic_decr(b);
-  if (rc == RC_SHARED && b->header.thread_shared) {
+  if (rc == RC_SHARED+1 && b->header.thread_shared) {  // (`rc` is the count before the decrement)
     b->header.refcount = 0;      // no more shared
     b->header.thread_shared = 0;   
     return true;                   // no more references
@@ -349,6 +352,15 @@ kk_decl_export void kk_block_mark_shared( kk_block_t* b, kk_context_t* ctx ) {
   }
 }
 
+// Make a block immortal with a sticky reference count that is never incremented or decremented.
+// Since the count never changes, the block can be used from any thread afterwards. The block
+// should not have scanned fields (as these are not marked) and should not be thread-shared yet.
+kk_decl_export void kk_block_make_sticky( kk_block_t* b ) {
+  kk_assert_internal(!b->header.thread_shared && kk_block_scan_fsize(b) == 0);
+  b->header.thread_shared = true;
+  b->header.refcount = RC_STICKY_HI;
+}
+
 kk_decl_export void kk_box_mark_shared( kk_box_t b, kk_context_t* ctx ) {
   if (kk_box_is_non_null_ptr(b)) {
     kk_block_mark_shared( kk_ptr_unbox(b), ctx );
@@ -0,0 +1,556 @@
+/*---------------------------------------------------------------------------
+  Copyright 2021, Microsoft Research, Daan Leijen.
+
+  This is free software; you can redistribute it and/or modify it under the
+  terms of the Apache License, Version 2.0. A copy of the License can be
+  found in the LICENSE file at the root of this distribution.
+---------------------------------------------------------------------------*/
+#include "kklib.h"
+
+/*--------------------------------------------------------------------------------------------------
+  Bulk kernels on unboxed arrays of doubles.
+  Each kernel has a portable scalar version. On x64 (with gcc or clang) there are also AVX2
+  and AVX-512 versions that are selected at runtime based on the cpu, and on arm64 there
+  is a NEON version. To keep results deterministic, reductions accumulate into 8 partial lanes
+  in the same order in every version (and use `fma` in the dot product), so all versions
+  return identical results.
+--------------------------------------------------------------------------------------------------*/
+
+#if (defined(__x86_64__) || defined(_M_X64)) && (defined(__GNUC__) || defined(__clang__))
+#define KK_SIMD_X64  1
+#include <immintrin.h>
+#elif (defined(__aarch64__) || defined(_M_ARM64))
+#define KK_SIMD_NEON 1
+#include <arm_neon.h>
+#endif
+
+typedef struct kk_simd_s {
+  const char* name;
+  void (*add)(double* r, const double* a, const double* b, kk_ssize_t n);
+  void (*sub)(double* r, const double* a, const double* b, kk_ssize_t n);
+  void (*mul)(double* r, const double* a, const double* b, kk_ssize_t n);
+  void (*fma)(double* r, const double* a, const double* b, const double* c, kk_ssize_t n);
+  void (*scale)(double* r, const double* a, double x, double y, kk_ssize_t n);
+  // reductions over `n` elements (a multiple of 8) into 8 partial lanes `acc`
+  void (*sum8)(double* acc, const double* a, kk_ssize_t n);
+  void (*dot8)(double* acc, const double* a, const double* b, kk_ssize_t n);
+  void (*min8)(double* acc, const double* a, kk_ssize_t n);
+  void (*max8)(double* acc, const double* a, kk_ssize_t n);
+  void (*cmp)(uint8_t* r, const double* a, kk_array_cmp_t cmp, double x, kk_ssize_t n);
+  void (*gather)(double* r, const double* a, const int32_t* idx, kk_ssize_t n);
+} kk_simd_t;
+
+
+/*--------------------------------------------------------------------------------------------------
+  Scalar kernels
+--------------------------------------------------------------------------------------------------*/
+
+static void kk_scalar_add(double* r, const double* a, const double* b, kk_ssize_t n) {
+  for (kk_ssize_t i = 0; i < n; i++) { r[i] = a[i] + b[i]; }
+}
+
+static void kk_scalar_sub(double* r, const double* a, const double* b, kk_ssize_t n) {
+  for (kk_ssize_t i = 0; i < n; i++) { r[i] = a[i] - b[i]; }
+}
+
+static void kk_scalar_mul(double* r, const double* a, const double* b, kk_ssize_t n) {
+  for (kk_ssize_t i = 0; i < n; i++) { r[i] = a[i] * b[i]; }
+}
+
+static void kk_scalar_fma(double* r, const double* a, const double* b, const double* c, kk_ssize_t n) {
+  for (kk_ssize_t i = 0; i < n; i++) { r[i] = fma(a[i], b[i], c[i]); }
+}
+
+static void kk_scalar_scale(double* r, const double* a, double x, double y, kk_ssize_t n) {
+  for (kk_ssize_t i = 0; i < n; i++) { r[i] = fma(a[i], x, y); }
+}
+
+static void kk_scalar_sum8(double* acc, const double* a, kk_ssize_t n) {
+  for (kk_ssize_t i = 0; i < n; i += 8) {
+    for (int j = 0; j < 8; j++) { acc[j] += a[i+j]; }
+  }
+}
+
+static void kk_scalar_dot8(double* acc, const double* a, const double* b, kk_ssize_t n) {
+  for (kk_ssize_t i = 0; i < n; i += 8) {
+    for (int j = 0; j < 8; j++) { acc[j] = fma(a[i+j], b[i+j], acc[j]); }
+  }
+}
+
+// same semantics as the `minpd` and `maxpd` instructions
+static inline double kk_simd_min(double x, double y) { return (x < y ? x : y); }
+static inline double kk_simd_max(double x, double y) { return (x > y ? x : y); }
+
+static void kk_scalar_min8(double* acc, const double* a, kk_ssize_t n) {
+  for (kk_ssize_t i = 0; i < n; i += 8) {
+    for (int j = 0; j < 8; j++) { acc[j] = kk_simd_min(acc[j], a[i+j]); }
+  }
+}
+
+static void kk_scalar_max8(double* acc, const double* a, kk_ssize_t n) {
+  for (kk_ssize_t i = 0; i < n; i += 8) {
+    for (int j = 0; j < 8; j++) { acc[j] = kk_simd_max(acc[j], a[i+j]); }
+  }
+}
+
+static void kk_scalar_cmp(uint8_t* r, const double* a, kk_array_cmp_t cmp, double x, kk_ssize_t n) {
+  switch (cmp) {
+    case KK_ARRAY_LT: for (kk_ssize_t i = 0; i < n; i++) { r[i] = (a[i] <  x); } break;
+    case KK_ARRAY_LE: for (kk_ssize_t i = 0; i < n; i++) { r[i] = (a[i] <= x); } break;
+    case KK_ARRAY_GT: for (kk_ssize_t i = 0; i < n; i++) { r[i] = (a[i] >  x); } break;
+    case KK_ARRAY_GE: for (kk_ssize_t i = 0; i < n; i++) { r[i] = (a[i] >= x); } break;
+    case KK_ARRAY_EQ: for (kk_ssize_t i = 0; i < n; i++) { r[i] = (a[i] == x); } break;
+    default:          for (kk_ssize_t i = 0; i < n; i++) { r[i] = (a[i] != x); } break;
+  }
+}
+
+static void kk_scalar_gather(double* r, const double* a, const int32_t* idx, kk_ssize_t n) {
+  for (kk_ssize_t i = 0; i < n; i++) { r[i] = a[idx[i]]; }
+}
+
+static const kk_simd_t kk_simd_scalar = {
+  "scalar", &kk_scalar_add, &kk_scalar_sub, &kk_scalar_mul, &kk_scalar_fma, &kk_scalar_scale,
+  &kk_scalar_sum8, &kk_scalar_dot8, &kk_scalar_min8, &kk_scalar_max8, &kk_scalar_cmp, &kk_scalar_gather
+};
+
+
+/*--------------------------------------------------------------------------------------------------
+  AVX2 and AVX-512 kernels
+--------------------------------------------------------------------------------------------------*/
+#if defined(KK_SIMD_X64)
+
+#define KK_AVX2    __attribute__((target("avx2,fma")))
+#define KK_AVX512  __attribute__((target("avx512f,avx2,fma")))
+
+#define kk_avx2_binop(name,op) \
+  static KK_AVX2 void kk_avx2_##name(double* r, const double* a, const double* b, kk_ssize_t n) { \
+    kk_ssize_t i = 0; \
+    for (; i + 4 <= n; i += 4) { _mm256_storeu_pd(r + i, op(_mm256_loadu_pd(a + i), _mm256_loadu_pd(b + i))); } \
+    kk_scalar_##name(r + i, a + i, b + i, n - i); \
+  }
+
+kk_avx2_binop(add, _mm256_add_pd)
+kk_avx2_binop(sub, _mm256_sub_pd)
+kk_avx2_binop(mul, _mm256_mul_pd)
+
+static KK_AVX2 void kk_avx2_fma(double* r, const double* a, const double* b, const double* c, kk_ssize_t n) {
+  kk_ssize_t i = 0;
+  for (; i + 4 <= n; i += 4) {
+    _mm256_storeu_pd(r + i, _mm256_fmadd_pd(_mm256_loadu_pd(a + i), _mm256_loadu_pd(b + i), _mm256_loadu_pd(c + i)));
+  }
+  kk_scalar_fma(r + i, a + i, b + i, c + i, n - i);
+}
+
+static KK_AVX2 void kk_avx2_scale(double* r, const double* a, double x, double y, kk_ssize_t n) {
+  const __m256d vx = _mm256_set1_pd(x);
+  const __m256d vy = _mm256_set1_pd(y);
+  kk_ssize_t i = 0;
+  for (; i + 4 <= n; i += 4) { _mm256_storeu_pd(r + i, _mm256_fmadd_pd(_mm256_loadu_pd(a + i), vx, vy)); }
+  kk_scalar_scale(r + i, a + i, x, y, n - i);
+}
+
+#define kk_avx2_reduce(name,op) \
+  static KK_AVX2 void kk_avx2_##name##8(double* acc, const double* a, kk_ssize_t n) { \
+    __m256d v0 = _mm256_loadu_pd(acc); \
+    __m256d v1 = _mm256_loadu_pd(acc + 4); \
+    for (kk_ssize_t i = 0; i < n; i += 8) { \
+      v0 = op(v0, _mm256_loadu_pd(a + i)); \
+      v1 = op(v1, _mm256_loadu_pd(a + i + 4)); \
+    } \
+    _mm256_storeu_pd(acc, v0); \
+    _mm256_storeu_pd(acc + 4, v1); \
+  }
+
+kk_avx2_reduce(sum, _mm256_add_pd)
+kk_avx2_reduce(min, _mm256_min_pd)
+kk_avx2_reduce(max, _mm256_max_pd)
+
+static KK_AVX2 void kk_avx2_dot8(double* acc, const double* a, const double* b, kk_ssize_t n) {
+  __m256d v0 = _mm256_loadu_pd(acc);
+  __m256d v1 = _mm256_loadu_pd(acc + 4);
+  for (kk_ssize_t i = 0; i < n; i += 8) {
+    v0 = _mm256_fmadd_pd(_mm256_loadu_pd(a + i), _mm256_loadu_pd(b + i), v0);
+    v1 = _mm256_fmadd_pd(_mm256_loadu_pd(a + i + 4), _mm256_loadu_pd(b + i + 4), v1);
+  }
+  _mm256_storeu_pd(acc, v0);
+  _mm256_storeu_pd(acc + 4, v1);
+}
+
+#define kk_avx2_cmp_loop(pred) \
+  for (; i + 4 <= n; i += 4) { \
+    const int m = _mm256_movemask_pd(_mm256_cmp_pd(_mm256_loadu_pd(a + i), vx, pred)); \
+    r[i] = (m & 1); r[i+1] = ((m >> 1) & 1); r[i+2] = ((m >> 2) & 1); r[i+3] = ((m >> 3) & 1); \
+  }
+
+static KK_AVX2 void kk_avx2_cmp(uint8_t* r, const double* a, kk_array_cmp_t cmp, double x, kk_ssize_t n) {
+  const __m256d vx = _mm256_set1_pd(x);
+  kk_ssize_t i = 0;
+  switch (cmp) {
+    case KK_ARRAY_LT: kk_avx2_cmp_loop(_CMP_LT_OQ);  break;
+    case KK_ARRAY_LE: kk_avx2_cmp_loop(_CMP_LE_OQ);  break;
+    case KK_ARRAY_GT: kk_avx2_cmp_loop(_CMP_GT_OQ);  break;
+    case KK_ARRAY_GE: kk_avx2_cmp_loop(_CMP_GE_OQ);  break;
+    case KK_ARRAY_EQ: kk_avx2_cmp_loop(_CMP_EQ_OQ);  break;
+    default:          kk_avx2_cmp_loop(_CMP_NEQ_UQ); break;
+  }
+  kk_scalar_cmp(r + i, a + i, cmp, x, n - i);
+}
+
+static KK_AVX2 void kk_avx2_gather(double* r, const double* a, const int32_t* idx, kk_ssize_t n) {
+  kk_ssize_t i = 0;
+  for (; i + 4 <= n; i += 4) {
+    _mm256_storeu_pd(r + i, _mm256_i32gather_pd(a, _mm_loadu_si128((const __m128i*)(idx + i)), 8));
+  }
+  kk_scalar_gather(r + i, a, idx + i, n - i);
+}
+
+static const kk_simd_t kk_simd_avx2 = {
+  "avx2", &kk_avx2_add, &kk_avx2_sub, &kk_avx2_mul, &kk_avx2_fma, &kk_avx2_scale,
+  &kk_avx2_sum8, &kk_avx2_dot8, &kk_avx2_min8, &kk_avx2_max8, &kk_avx2_cmp, &kk_avx2_gather
+};
+
+#define kk_avx512_binop(name,op) \
+  static KK_AVX512 void kk_avx512_##name(double* r, const double* a, const double* b, kk_ssize_t n) { \
+    kk_ssize_t i = 0; \
+    for (; i + 8 <= n; i += 8) { _mm512_storeu_pd(r + i, op(_mm512_loadu_pd(a + i), _mm512_loadu_pd(b + i))); } \
+    kk_avx2_##name(r + i, a + i, b + i, n - i); \
+  }
+
+kk_avx512_binop(add, _mm512_add_pd)
+kk_avx512_binop(sub, _mm512_sub_pd)
+kk_avx512_binop(mul, _mm512_mul_pd)
+
+static KK_AVX512 void kk_avx512_fma(double* r, const double* a, const double* b, const double* c, kk_ssize_t n) {
+  kk_ssize_t i = 0;
+  for (; i + 8 <= n; i += 8) {
+    _mm512_storeu_pd(r + i, _mm512_fmadd_pd(_mm512_loadu_pd(a + i), _mm512_loadu_pd(b + i), _mm512_loadu_pd(c + i)));
+  }
+  kk_avx2_fma(r + i, a + i, b + i, c + i, n - i);
+}
+
+static KK_AVX512 void kk_avx512_scale(double* r, const double* a, double x, double y, kk_ssize_t n) {
+  const __m512d vx = _mm512_set1_pd(x);
+  const __m512d vy = _mm512_set1_pd(y);
+  kk_ssize_t i = 0;
+  for (; i + 8 <= n; i += 8) { _mm512_storeu_pd(r + i, _mm512_fmadd_pd(_mm512_loadu_pd(a + i), vx, vy)); }
+  kk_avx2_scale(r + i, a + i, x, y, n - i);
+}
+
+#define kk_avx512_reduce(name,op) \
+  static KK_AVX512 void kk_avx512_##name##8(double* acc, const double* a, kk_ssize_t n) { \
+    __m512d v = _mm512_loadu_pd(acc); \
+    for (kk_ssize_t i = 0; i < n; i += 8) { v = op(v, _mm512_loadu_pd(a + i)); } \
+    _mm512_storeu_pd(acc, v); \
+  }
+
+kk_avx512_reduce(sum, _mm512_add_pd)
+kk_avx512_reduce(min, _mm512_min_pd)
+kk_avx512_reduce(max, _mm512_max_pd)
+
+static KK_AVX512 void kk_avx512_dot8(double* acc, const double* a, const double* b, kk_ssize_t n) {
+  __m512d v = _mm512_loadu_pd(acc);
+  for (kk_ssize_t i = 0; i < n; i += 8) {
+    v = _mm512_fmadd_pd(_mm512_loadu_pd(a + i), _mm512_loadu_pd(b + i), v);
+  }
+  _mm512_storeu_pd(acc, v);
+}
+
+static const kk_simd_t kk_simd_avx512 = {
+  "avx512", &kk_avx512_add, &kk_avx512_sub, &kk_avx512_mul, &kk_avx512_fma, &kk_avx512_scale,
+  &kk_avx512_sum8, &kk_avx512_dot8, &kk_avx512_min8, &kk_avx512_max8, &kk_avx2_cmp, &kk_avx2_gather
+};
+
+
+/*--------------------------------------------------------------------------------------------------
+  NEON kernels
+--------------------------------------------------------------------------------------------------*/
+#elif defined(KK_SIMD_NEON)
+
+#define kk_neon_binop(name,op) \
+  static void kk_neon_##name(double* r, const double* a, const double* b, kk_ssize_t n) { \
+    kk_ssize_t i = 0; \
+    for (; i + 2 <= n; i += 2) { vst1q_f64(r + i, op(vld1q_f64(a + i), vld1q_f64(b + i))); } \
+    kk_scalar_##name(r + i, a + i, b + i, n - i); \
+  }
+
+kk_neon_binop(add, vaddq_f64)
+kk_neon_binop(sub, vsubq_f64)
+kk_neon_binop(mul, vmulq_f64)
+
+static void kk_neon_fma(double* r, const double* a, const double* b, const double* c, kk_ssize_t n) {
+  kk_ssize_t i = 0;
+  for (; i + 2 <= n; i += 2) { vst1q_f64(r + i, vfmaq_f64(vld1q_f64(c + i), vld1q_f64(a + i), vld1q_f64(b + i))); }
+  kk_scalar_fma(r + i, a + i, b + i, c + i, n - i);
+}
+
+static void kk_neon_scale(double* r, const double* a, double x, double y, kk_ssize_t n) {
+  const float64x2_t vx = vdupq_n_f64(x);
+  const float64x2_t vy = vdupq_n_f64(y);
+  kk_ssize_t i = 0;
+  for (; i + 2 <= n; i += 2) { vst1q_f64(r + i, vfmaq_f64(vy, vld1q_f64(a + i), vx)); }
+  kk_scalar_scale(r + i, a + i, x, y, n - i);
+}
+
+static inline float64x2_t kk_neon_min_pd(float64x2_t x, float64x2_t y) { return vbslq_f64(vcltq_f64(x, y), x, y); }
+static inline float64x2_t kk_neon_max_pd(float64x2_t x, float64x2_t y) { return vbslq_f64(vcgtq_f64(x, y), x, y); }
+
+#define kk_neon_reduce(name,op) \
+  static void kk_neon_##name##8(double* acc, const double* a, kk_ssize_t n) { \
+    float64x2_t v0 = vld1q_f64(acc), v1 = vld1q_f64(acc + 2), v2 = vld1q_f64(acc + 4), v3 = vld1q_f64(acc + 6); \
+    for (kk_ssize_t i = 0; i < n; i += 8) { \
+      v0 = op(v0, vld1q_f64(a + i));     v1 = op(v1, vld1q_f64(a + i + 2)); \
+      v2 = op(v2, vld1q_f64(a + i + 4)); v3 = op(v3, vld1q_f64(a + i + 6)); \
+    } \
+    vst1q_f64(acc, v0); vst1q_f64(acc + 2, v1); vst1q_f64(acc + 4, v2); vst1q_f64(acc + 6, v3); \
+  }
+
+kk_neon_reduce(sum, vaddq_f64)
+kk_neon_reduce(min, kk_neon_min_pd)
+kk_neon_reduce(max, kk_neon_max_pd)
+
+static void kk_neon_dot8(double* acc, const double* a, const double* b, kk_ssize_t n) {
+  float64x2_t v0 = vld1q_f64(acc), v1 = vld1q_f64(acc + 2), v2 = vld1q_f64(acc + 4), v3 = vld1q_f64(acc + 6);
+  for (kk_ssize_t i = 0; i < n; i += 8) {
+    v0 = vfmaq_f64(v0, vld1q_f64(a + i), vld1q_f64(b + i));
+    v1 = vfmaq_f64(v1, vld1q_f64(a + i + 2), vld1q_f64(b + i + 2));
+    v2 = vfmaq_f64(v2, vld1q_f64(a + i + 4), vld1q_f64(b + i + 4));
+    v3 = vfmaq_f64(v3, vld1q_f64(a + i + 6), vld1q_f64(b + i + 6));
+  }
+  vst1q_f64(acc, v0); vst1q_f64(acc + 2, v1); vst1q_f64(acc + 4, v2); vst1q_f64(acc + 6, v3);
+}
+
+static const kk_simd_t kk_simd_neon = {
+  "neon", &kk_neon_add, &kk_neon_sub, &kk_neon_mul, &kk_neon_fma, &kk_neon_scale,
+  &kk_neon_sum8, &kk_neon_dot8, &kk_neon_min8, &kk_neon_max8, &kk_scalar_cmp, &kk_scalar_gather
+};
+
+#endif
+
+
+/*--------------------------------------------------------------------------------------------------
+  Runtime selection
+--------------------------------------------------------------------------------------------------*/
+
+static const kk_simd_t* kk_simd_kernels = NULL;
+
+static const kk_simd_t* kk_simd(void) {
+  const kk_simd_t* simd = kk_simd_kernels;
+  if (kk_likely(simd != NULL)) return simd;
+  // benign race: every thread selects the same kernels
+  #if defined(KK_SIMD_X64)
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx512f")) { simd = &kk_simd_avx512; }
+  else if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) { simd = &kk_simd_avx2; }
+  else { simd = &kk_simd_scalar; }
+  #elif defined(KK_SIMD_NEON)
+  simd = &kk_simd_neon;
+  #else
+  simd = &kk_simd_scalar;
+  #endif
+  kk_simd_kernels = simd;
+  return simd;
+}
+
+const char* kk_array_simd_name(void) {
+  return kk_simd()->name;
+}
+
+
+/*--------------------------------------------------------------------------------------------------
+  Array operations
+--------------------------------------------------------------------------------------------------*/
+
+// Return an array for the result of an element-wise operation of length `n`: this is `a` if it is unique
+// (and of length `n`), or a fresh array otherwise.
+static kk_box_t kk_array_double_result(kk_box_t a, kk_ssize_t n, double** r, kk_context_t* ctx) {
+  if (kk_block_is_unique(kk_ptr_unbox(a)) && kk_array_len_borrow(a) == n) {
+    *r = kk_array_double_buf_borrow(a, NULL);
+    return kk_box_dup(a);
+  }
+  else {
+    return kk_array_alloc(n, kk_ssizeof(double), (void**)r, ctx);
+  }
+}
+
+static kk_ssize_t kk_array_min_len(kk_box_t a, kk_box_t b) {
+  const kk_ssize_t n = kk_array_len_borrow(a);
+  const kk_ssize_t m = kk_array_len_borrow(b);
+  return (n < m ? n : m);
+}
+
+#define kk_array_double_binop(name) \
+  kk_box_t kk_array_double_##name(kk_box_t a, kk_box_t b, kk_context_t* ctx) { \
+    const kk_ssize_t n = kk_array_min_len(a, b); \
+    double* r; \
+    kk_box_t res = kk_array_double_result(a, n, &r, ctx); \
+    kk_simd()->name(r, kk_array_double_buf_borrow(a, NULL), kk_array_double_buf_borrow(b, NULL), n); \
+    kk_box_drop(a, ctx); \
+    kk_box_drop(b, ctx); \
+    return res; \
+  }
+
+kk_array_double_binop(add)
+kk_array_double_binop(sub)
+kk_array_double_binop(mul)
+
+kk_box_t kk_array_double_fma(kk_box_t a, kk_box_t b, kk_box_t c, kk_context_t* ctx) {
+  kk_ssize_t n = kk_array_min_len(a, b);
+  const kk_ssize_t m = kk_array_len_borrow(c);
+  if (m < n) n = m;
+  double* r;
+  kk_box_t res = kk_array_double_result(a, n, &r, ctx);
+  kk_simd()->fma(r, kk_array_double_buf_borrow(a, NULL), kk_array_double_buf_borrow(b, NULL), kk_array_double_buf_borrow(c, NULL), n);
+  kk_box_drop(a, ctx);
+  kk_box_drop(b, ctx);
+  kk_box_drop(c, ctx);
+  return res;
+}
+
+kk_box_t kk_array_double_scale(kk_box_t a, double x, double y, kk_context_t* ctx) {
+  kk_ssize_t n;
+  const double* p = kk_array_double_buf_borrow(a, &n);
+  double* r;
+  kk_box_t res = kk_array_double_result(a, n, &r, ctx);
+  kk_simd()->scale(r, p, x, y, n);
+  kk_box_drop(a, ctx);
+  return res;
+}
+
+static double kk_simd_sum_lanes(const double* acc) {
+  return (((acc[0] + acc[1]) + (acc[2] + acc[3])) + ((acc[4] + acc[5]) + (acc[6] + acc[7])));
+}
+
+double kk_array_double_sum(kk_box_t a, kk_context_t* ctx) {
+  kk_ssize_t n;
+  const double* p = kk_array_double_buf_borrow(a, &n);
+  const kk_ssize_t n8 = (n / 8) * 8;
+  double acc[8] = { 0 };
+  kk_simd()->sum8(acc, p, n8);
+  double sum = kk_simd_sum_lanes(acc);
+  for (kk_ssize_t i = n8; i < n; i++) { sum += p[i]; }
+  kk_box_drop(a, ctx);
+  return sum;
+}
+
+double kk_array_double_dot(kk_box_t a, kk_box_t b, kk_context_t* ctx) {
+  const kk_ssize_t n = kk_array_min_len(a, b);
+  const double* p = kk_array_double_buf_borrow(a, NULL);
+  const double* q = kk_array_double_buf_borrow(b, NULL);
+  const kk_ssize_t n8 = (n / 8) * 8;
+  double acc[8] = { 0 };
+  kk_simd()->dot8(acc, p, q, n8);
+  double sum = kk_simd_sum_lanes(acc);
+  for (kk_ssize_t i = n8; i < n; i++) { sum = fma(p[i], q[i], sum); }
+  kk_box_drop(a, ctx);
+  kk_box_drop(b, ctx);
+  return sum;
+}
+
+static double kk_array_double_minmax(kk_box_t a, bool is_min, kk_context_t* ctx) {
+  kk_ssize_t n;
+  const double* p = kk_array_double_buf_borrow(a, &n);
+  double m = NAN;
+  if (n > 0) {
+    // the first 8 elements initialize the lanes
+    const kk_ssize_t n8 = (n >= 8 ? (n / 8) * 8 : 0);
+    double acc[8];
+    kk_ssize_t i = 0;
+    if (n8 > 0) {
+      memcpy(acc, p, 8*sizeof(double));
+      if (is_min) { kk_simd()->min8(acc, p + 8, n8 - 8); }
+             else { kk_simd()->max8(acc, p + 8, n8 - 8); }
+      m = acc[0];
+      for (int j = 1; j < 8; j++) { m = (is_min ? kk_simd_min(m, acc[j]) : kk_simd_max(m, acc[j])); }
+      i = n8;
+    }
+    else {
+      m = p[0];
+      i = 1;
+    }
+    for (; i < n; i++) { m = (is_min ? kk_simd_min(m, p[i]) : kk_simd_max(m, p[i])); }
+  }
+  kk_box_drop(a, ctx);
+  return m;
+}
+
+double kk_array_double_min(kk_box_t a, kk_context_t* ctx) {
+  return kk_array_double_minmax(a, true, ctx);
+}
+
+double kk_array_double_max(kk_box_t a, kk_context_t* ctx) {
+  return kk_array_double_minmax(a, false, ctx);
+}
+
+// The prefix sum is inherently sequential (and a vectorized version would change the rounding).
+kk_box_t kk_array_double_prefix_sum(kk_box_t a, kk_context_t* ctx) {
+  kk_ssize_t n;
+  const double* p = kk_array_double_buf_borrow(a, &n);
+  double* r;
+  kk_box_t res = kk_array_double_result(a, n, &r, ctx);
+  double sum = 0.0;
+  for (kk_ssize_t i = 0; i < n; i++) {
+    sum += p[i];
+    r[i] = sum;
+  }
+  kk_box_drop(a, ctx);
+  return res;
+}
+
+kk_box_t kk_array_double_cmp(kk_box_t a, int32_t cmp, double x, kk_context_t* ctx) {
+  kk_ssize_t n;
+  const double* p = kk_array_double_buf_borrow(a, &n);
+  uint8_t* r;
+  kk_box_t res = kk_array_alloc(n, 1, (void**)&r, ctx);
+  kk_simd()->cmp(r, p, (kk_array_cmp_t)cmp, x, n);
+  kk_box_drop(a, ctx);
+  return res;
+}
+
+static bool kk_array_indices_valid(const int32_t* idx, kk_ssize_t n, kk_ssize_t len) {
+  for (kk_ssize_t i = 0; i < n; i++) {
+    if (idx[i] < 0 || idx[i] >= len) return false;
+  }
+  return true;
+}
+
+int kk_array_double_gather(kk_box_t a, kk_box_t idx, kk_box_t* result, kk_context_t* ctx) {
+  kk_ssize_t len;
+  kk_ssize_t n;
+  const double* p = kk_array_double_buf_borrow(a, &len);
+  const int32_t* ix = kk_array_int32_buf_borrow(idx, &n);
+  int err = 0;
+  if (!kk_array_indices_valid(ix, n, len)) {
+    *result = kk_box_null;
+    err = ERANGE;
+  }
+  else {
+    double* r;
+    *result = kk_array_alloc(n, kk_ssizeof(double), (void**)&r, ctx);
+    kk_simd()->gather(r, p, ix, n);
+  }
+  kk_box_drop(a, ctx);
+  kk_box_drop(idx, ctx);
+  return err;
+}
+
+// Scatter is sequential so later indices win on duplicates.
+int kk_array_double_scatter(kk_box_t a, kk_box_t idx, kk_box_t v, kk_box_t* result, kk_context_t* ctx) {
+  const kk_ssize_t n = kk_array_min_len(idx, v);
+  const int32_t* ix = kk_array_int32_buf_borrow(idx, NULL);
+  const double* q = kk_array_double_buf_borrow(v, NULL);
+  int err = 0;
+  if (!kk_array_indices_valid(ix, n, kk_array_len_borrow(a))) {
+    kk_box_drop(a, ctx);
+    *result = kk_box_null;
+    err = ERANGE;
+  }
+  else {
+    a = kk_array_ensure_unique(a, ctx);
+    double* r = kk_array_double_buf_borrow(a, NULL);
+    for (kk_ssize_t i = 0; i < n; i++) { r[ix[i]] = q[i]; }
+    *result = a;
+  }
+  kk_box_drop(idx, ctx);
+  kk_box_drop(v, ctx);
+  return err;
+}
@@ -64,6 +64,118 @@ int kk_string_icmp(kk_string_t str1, kk_string_t str2, kk_context_t* ctx) {
   return ord;
 }
 
+// Hash 8 bytes at a time with a multiply-rotate step and mix the result at the end.
+uint64_t kk_decl_pure kk_string_hash_borrow(kk_string_t str) {
+  kk_ssize_t len;
+  const uint8_t* s = kk_string_buf_borrow(str, &len);
+  uint64_t h = KU64(0x9E3779B97F4A7C15) ^ (uint64_t)len;
+  for (; len >= 8; len -= 8, s += 8) {
+    uint64_t w;
+    memcpy(&w, s, 8);
+    h = (h ^ (w * KU64(0x87C37B91114253D5))) * KU64(0x4CF5AD432745937F);
+    h = (h << 31) | (h >> 33);
+  }
+  if (len > 0) {
+    uint64_t w = 0;
+    memcpy(&w, s, (size_t)len);
+    h = (h ^ (w * KU64(0x87C37B91114253D5))) * KU64(0x4CF5AD432745937F);
+  }
+  return kk_bits_mix64(h);
+}
+
+int32_t kk_string_hash32(kk_string_t str, kk_context_t* ctx) {
+  const uint64_t h = kk_string_hash_borrow(str);
+  kk_string_drop(str, ctx);
+  return (int32_t)(uint32_t)(h ^ (h >> 32));
+}
+
+
+
+/*--------------------------------------------------------------------------------------------------
+  Interned strings
+  A process-wide open-addressing table (with linear probing) of sticky strings, protected by a
+  spin lock (interning is not expected to be contended). Interned strings are never freed since
+  any thread can hold on to them; the table is allocated with the C allocator so it does not
+  belong to the heap of the thread that happened to create or grow it.
+--------------------------------------------------------------------------------------------------*/
+
+typedef struct kk_intern_entry_s {
+  uint64_t    hash;
+  kk_block_t* str;        // NULL if the entry is empty
+} kk_intern_entry_t;
+
+static kk_ssize_t         kk_intern_count;
+static kk_ssize_t         kk_intern_capacity;  // 0 or a power of 2
+static kk_intern_entry_t* kk_intern_entries;
+static _Atomic(uintptr_t) kk_intern_lock;
+
+static void kk_intern_acquire(void) {
+  uintptr_t expected = 0;
+  while (!kk_atomic_cas_weak_acq_rel(&kk_intern_lock, &expected, 1)) {
+    expected = 0;
+  }
+}
+
+static void kk_intern_release(void) {
+  kk_atomic_store_release(&kk_intern_lock, 0);
+}
+
+static bool kk_intern_grow(void) {
+  const kk_ssize_t capacity = (kk_intern_capacity == 0 ? 64 : 2*kk_intern_capacity);
+  const uint64_t mask = (uint64_t)capacity - 1;
+  kk_intern_entry_t* entries = (kk_intern_entry_t*)calloc((size_t)capacity, sizeof(kk_intern_entry_t));
+  if (entries == NULL) return false;
+  for (kk_ssize_t i = 0; i < kk_intern_capacity; i++) {
+    const kk_intern_entry_t e = kk_intern_entries[i];
+    if (e.str == NULL) continue;
+    uint64_t j = e.hash & mask;
+    while (entries[j].str != NULL) { j = (j + 1) & mask; }
+    entries[j] = e;
+  }
+  free(kk_intern_entries);
+  kk_intern_entries = entries;
+  kk_intern_capacity = capacity;
+  return true;
+}
+
+kk_string_t kk_string_intern(kk_string_t str, kk_context_t* ctx) {
+  if (kk_string_is_empty_borrow(str)) {
+    kk_string_drop(str, ctx);
+    return kk_string_empty();
+  }
+  // flatten first so ropes are not flattened while holding the lock
+  kk_ssize_t len;
+  const uint8_t* buf = kk_bytes_buf_borrow(str.bytes, &len);
+  const uint64_t hash = kk_string_hash_borrow(str);
+  kk_intern_acquire();
+  if (2*(kk_intern_count + 1) > kk_intern_capacity && !kk_intern_grow()) {
+    kk_intern_release();
+    return str;  // out of memory: return the string as is (it is still a valid string)
+  }
+  const uint64_t mask = (uint64_t)kk_intern_capacity - 1;
+  uint64_t i = hash & mask;
+  while (kk_intern_entries[i].str != NULL) {
+    const kk_intern_entry_t e = kk_intern_entries[i];
+    if (e.hash == hash && kk_bytes_cmp_borrow(kk_datatype_from_ptr(e.str), str.bytes) == 0) {
+      kk_intern_release();
+      kk_string_drop(str, ctx);
+      return kk_unsafe_bytes_as_string_unchecked(kk_datatype_from_ptr(e.str));  // no need to dup a sticky string
+    }
+    i = (i + 1) & mask;
+  }
+  // not found: make it sticky in-place if we can, or otherwise intern a (flat) copy
+  kk_bytes_t b = str.bytes;
+  if (!kk_datatype_is_unique(b) || !(kk_datatype_has_tag(b, KK_TAG_BYTES) || kk_datatype_has_tag(b, KK_TAG_BYTES_SMALL))) {
+    b = kk_bytes_alloc_dupn(len, buf, ctx);
+    kk_string_drop(str, ctx);
+  }
+  kk_block_make_sticky(kk_datatype_as_ptr(b));
+  kk_intern_entries[i].hash = hash;
+  kk_intern_entries[i].str = kk_datatype_as_ptr(b);
+  kk_intern_count++;
+  kk_intern_release();
+  return kk_unsafe_bytes_as_string_unchecked(b);
+}
 
 // Count code points in a valid utf-8 string.
 kk_ssize_t kk_decl_pure kk_string_count_borrow(kk_string_t str) {
@@ -72,7 +184,6 @@ kk_ssize_t kk_decl_pure kk_string_count_borrow(kk_string_t str) {
   kk_ssize_t cont = 0;      // continuation character counts
   const uint8_t* t = s; // current position 
   const uint8_t* end = t + len;
-  kk_assert_internal(*end == 0);
 
   // advance per byte until aligned
   for (; ((((uintptr_t)t) % sizeof(kk_uintx_t)) != 0) && (t < end); t++) {
@@ -417,13 +528,13 @@ const char* kk_string_to_qutf8_borrow(kk_string_t str, bool* should_free, kk_con
     }
   }
   kk_assert_internal(p == end);
-  if (extra_count == 0) {
+  if (extra_count == 0 && *end == 0) {
     *should_free = false;
     return (const char*)s;
   }
 
-  // contains raw bytes, allocate a buffer;
-  kk_assert_internal(extra_count < len);
+  // contains raw bytes (or is a view that is not zero terminated), allocate a buffer;
+  kk_assert_internal(extra_count <= len);
   const kk_ssize_t blen = len - extra_count;
   uint8_t* bstr = (uint8_t*)kk_malloc(blen + 1, ctx);
   bstr[blen] = 0;
@@ -703,6 +814,34 @@ kk_string_t kk_string_from_chars(kk_vector_t v, kk_context_t* ctx) {
   return s;
 }
 
+static bool kk_string_builder_copy_chunk(const uint8_t* buf, kk_ssize_t len, void* arg) {
+  uint8_t** p = (uint8_t**)arg;
+  kk_memcpy(*p, buf, len);
+  *p += len;
+  return true;
+}
+
+kk_string_builder_t kk_string_builder_append(kk_string_builder_t sb, kk_string_t s, kk_context_t* ctx) {
+  const kk_ssize_t len = kk_string_len_borrow(s);
+  if (len == 0) {
+    kk_string_drop(s, ctx);
+    return sb;
+  }
+  uint8_t* p;
+  sb = kk_string_builder_reserve(sb, len, &p, ctx);
+  kk_string_foreach_chunk_borrow(s, &kk_string_builder_copy_chunk, &p);  // does not flatten ropes
+  kk_string_drop(s, ctx);
+  return kk_string_builder_advance(sb, len);
+}
+
+kk_string_builder_t kk_string_builder_append_char(kk_string_builder_t sb, kk_char_t c, kk_context_t* ctx) {
+  uint8_t* p;
+  kk_ssize_t count;
+  sb = kk_string_builder_reserve(sb, 4, &p, ctx);
+  kk_utf8_write(c, p, &count);
+  return kk_string_builder_advance(sb, count);
+}
+
 kk_vector_t kk_string_to_chars(kk_string_t s, kk_context_t* ctx) {
   kk_ssize_t n = kk_string_count_borrow(s);
   kk_box_t* cs;
@@ -761,12 +900,11 @@ kk_vector_t kk_string_splitv_atmost(kk_string_t str, kk_string_t sepstr, kk_ssiz
     }
     kk_assert_internal(r != NULL && r >= p && r < end);
     const kk_ssize_t partlen = (r - p);
-    v[i] = kk_string_box(kk_string_alloc_dupn_valid_utf8(partlen, p, ctx));
+    v[i] = kk_string_box(kk_string_view(kk_string_dup(str), p - s, partlen, ctx));
     p = r + seplen;  // advance
   }
   kk_assert_internal(p <= end);
-  v[count-1] = kk_string_box(kk_string_alloc_dupn_valid_utf8(end - p, p, ctx));  // todo: share string if p == s ?
-  kk_string_drop(str, ctx);
+  v[count-1] = kk_string_box(kk_string_view(str, p - s, end - p, ctx));
   kk_string_drop(sepstr, ctx);
   return vec;
 }
@@ -781,7 +919,7 @@ kk_string_t kk_string_to_upper(kk_string_t str, kk_context_t* ctx) {
   kk_ssize_t len;
   const uint8_t* s = kk_string_buf_borrow(str, &len);
   kk_string_t tstr;
-  if (kk_datatype_is_unique(str.bytes)) {
+  if (kk_bytes_is_unique_owned(str.bytes)) {
     tstr = str;  // update in-place
   }
   else {
@@ -801,7 +939,7 @@ kk_string_t  kk_string_to_lower(kk_string_t str, kk_context_t* ctx) {
   kk_ssize_t len;
   const uint8_t* s = kk_string_buf_borrow(str, &len);
   kk_string_t tstr;
-  if (kk_datatype_is_unique(str.bytes)) {
+  if (kk_bytes_is_unique_owned(str.bytes)) {
     tstr = str;  // update in-place
   }
   else {
@@ -820,13 +958,11 @@ kk_string_t  kk_string_to_lower(kk_string_t str, kk_context_t* ctx) {
 kk_string_t  kk_string_trim_left(kk_string_t str, kk_context_t* ctx) {
   kk_ssize_t len;
   const uint8_t* s = kk_string_buf_borrow(str, &len);
+  const uint8_t* const end = s + len;
   const uint8_t* p = s;
-  for (; *p != 0 && kk_ascii_iswhite(*p); p++) {}
+  for (; p < end && kk_ascii_iswhite(*p); p++) {}
   if (p == s) return str;           // no trim needed
-  const kk_ssize_t tlen = len - (p - s);      // todo: if s is unique and tlen close to slen, move inplace?
-  kk_string_t tstr = kk_string_alloc_dupn_valid_utf8(tlen, p, ctx);
-  kk_string_drop(str, ctx);
-  return tstr;
+  return kk_string_view(str, p - s, end - p, ctx);
 }
 
 kk_string_t  kk_string_trim_right(kk_string_t str, kk_context_t* ctx) {
@@ -836,31 +972,39 @@ kk_string_t  kk_string_trim_right(kk_string_t str, kk_context_t* ctx) {
   for (; p >= s && kk_ascii_iswhite(*p); p--) {}
   const kk_ssize_t tlen = (p - s) + 1;
   if (len == tlen) return str;  // no trim needed
-  kk_string_t tstr = kk_string_alloc_dupn_valid_utf8(tlen, s, ctx);
-  kk_string_drop(str, ctx);
-  return tstr;
+  return kk_string_view(str, 0, tlen, ctx);
 }
 
 /*--------------------------------------------------------------------------------------------------
 
 --------------------------------------------------------------------------------------------------*/
 
+static bool kk_fwrite_chunk(const uint8_t* buf, kk_ssize_t len, void* out) {
+  return (fwrite(buf, 1, kk_to_size_t(len), (FILE*)out) == kk_to_size_t(len));
+}
+
+// write in chunks so ropes are not flattened (this also writes embedded 0 characters)
+static void kk_fputs(kk_string_t s, FILE* out) {
+  kk_string_foreach_chunk_borrow(s, &kk_fwrite_chunk, out);
+}
+
 kk_unit_t kk_println(kk_string_t s, kk_context_t* ctx) {
   // TODO: set locale to utf-8?
-  puts(kk_string_cbuf_borrow(s, NULL));  // todo: allow printing embedded 0 characters?
+  kk_fputs(s, stdout);
+  fputc('\n', stdout);
   kk_string_drop(s, ctx);
   return kk_Unit;
 }
 
 kk_unit_t kk_print(kk_string_t s, kk_context_t* ctx) {
   // TODO: set locale to utf-8?
-  fputs(kk_string_cbuf_borrow(s, NULL), stdout); // todo: allow printing embedded 0 characters?
+  kk_fputs(s, stdout);
   kk_string_drop(s, ctx);
   return kk_Unit;
 }
 
 kk_unit_t kk_trace(kk_string_t s, kk_context_t* ctx) {
-  fputs(kk_string_cbuf_borrow(s, NULL), stderr); // todo: allow printing embedded 0 characters?
+  kk_fputs(s, stderr);
   fputs("\n", stderr);
   kk_string_drop(s, ctx);
   return kk_Unit;
@@ -874,22 +1018,26 @@ kk_unit_t kk_trace_any(kk_string_t s, kk_box_t x, kk_context_t* ctx) {
 }
 
 
-static kk_string_t kk_double_show_special(double d, kk_context_t* ctx) {
+static const char* kk_double_show_special(double d) {
   if (d == HUGE_VAL) {
-    return kk_string_alloc_dup_valid_utf8("inf", ctx);
+    return "inf";
   }
   else if (d == -HUGE_VAL) {
-    return kk_string_alloc_dup_valid_utf8("-inf", ctx);
+    return "-inf";
   }
   else {
     kk_assert(isnan(d));
-    return kk_string_alloc_dup_valid_utf8("nan", ctx);
+    return "nan";
   }
 }
 
-static kk_string_t kk_double_show_spec(double d, int32_t prec, char spec, kk_context_t* ctx) {
-  if (!isfinite(d)) return kk_double_show_special(d, ctx);
-  char buf[64];
+// Show a double into `buf` (of at least 64 bytes) and return the length of the result.
+static kk_ssize_t kk_double_show_buf(double d, int32_t prec, char spec, char* buf) {
+  if (!isfinite(d)) {
+    const char* s = kk_double_show_special(d);
+    strcpy(buf, s);
+    return kk_sstrlen(s);
+  }
   char fmt[16];
   if (prec < 0)  prec = -prec;
   if (prec > 48) prec = 48;
@@ -904,8 +1052,16 @@ static kk_string_t kk_double_show_spec(double d, int32_t prec, char spec, kk_con
     && (p[3] == 0 || (p[3] == '0' && (p[4] == 0 || (p[4] == '0' && p[5] == 0)))))
   {
     *p = 0; // remove exponent
+    return (p - buf);
   }
-  return kk_string_alloc_dup_valid_utf8(buf, ctx);
+  while (*p != 0) { p++; }
+  return (p - buf);
+}
+
+static kk_string_t kk_double_show_spec(double d, int32_t prec, char spec, kk_context_t* ctx) {
+  char buf[64];
+  const kk_ssize_t len = kk_double_show_buf(d, prec, spec, buf);
+  return kk_string_alloc_dupn_valid_utf8(len, (const uint8_t*)buf, ctx);
 }
 
 kk_string_t kk_double_show_fixed(double d, int32_t prec, kk_context_t* ctx) {
@@ -920,6 +1076,26 @@ kk_string_t kk_double_show(double d, int32_t prec, kk_context_t* ctx) {
   return kk_double_show_spec(d, prec, 'g', ctx);
 }
 
+// Show a double directly into a string builder
+static kk_string_builder_t kk_string_builder_append_double_spec(kk_string_builder_t sb, double d, int32_t prec, char spec, kk_context_t* ctx) {
+  uint8_t* p;
+  sb = kk_string_builder_reserve(sb, 64, &p, ctx);
+  const kk_ssize_t len = kk_double_show_buf(d, prec, spec, (char*)p);
+  return kk_string_builder_advance(sb, len);
+}
+
+kk_string_builder_t kk_string_builder_append_double_fixed(kk_string_builder_t sb, double d, int32_t prec, kk_context_t* ctx) {
+  return kk_string_builder_append_double_spec(sb, d, prec, prec < 0 ? 'g' : 'f', ctx);
+}
+
+kk_string_builder_t kk_string_builder_append_double_exp(kk_string_builder_t sb, double d, int32_t prec, kk_context_t* ctx) {
+  return kk_string_builder_append_double_spec(sb, d, prec, prec < 0 ? 'g' : 'e', ctx);
+}
+
+kk_string_builder_t kk_string_builder_append_double(kk_string_builder_t sb, double d, int32_t prec, kk_context_t* ctx) {
+  return kk_string_builder_append_double_spec(sb, d, prec, 'g', ctx);
+}
+
 
 
 kk_string_t kk_show_any(kk_box_t b, kk_context_t* ctx) {
@@ -947,7 +1123,7 @@ kk_string_t kk_show_any(kk_box_t b, kk_context_t* ctx) {
         // todo: add tag
         return kk_integer_to_string(kk_integer_unbox(b), ctx);
       }
-      else if (tag == KK_TAG_STRING_SMALL || tag == KK_TAG_STRING || tag == KK_TAG_STRING_RAW) {
+      else if (tag == KK_TAG_STRING_SMALL || tag == KK_TAG_STRING || tag == KK_TAG_STRING_RAW || tag == KK_TAG_STRING_ROPE || tag == KK_TAG_STRING_VIEW) {
         // todo: add tag
         return kk_string_unbox(b);
       }
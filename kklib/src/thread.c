@@ -8,6 +8,14 @@
 #include "kklib.h"
 #include "kklib/thread.h"
 
+// default stack size for the main entry and task group workers (see `kk_main_run`)
+#if (KK_INTPTR_SIZE >= 8)
+#define KK_STACK_SIZE_DEFAULT ((size_t)1024*1024*1024)   // 1GiB
+#else
+#define KK_STACK_SIZE_DEFAULT ((size_t)64*1024*1024)     // 64MiB
+#endif
+#define KK_STACK_GUARD_SIZE   (64*1024)                   // guard area at the end of the stack
+
 
 /*---------------------------------------------------------------------------
   for windows, add a minimal pthread emulation layer
@@ -30,20 +38,32 @@ typedef struct kk_thread_proc_arg_s {
 
 static DWORD WINAPI kk_thread_proc(LPVOID varg) {
   kk_thread_proc_arg_t arg = *((kk_thread_proc_arg_t*)varg);
-  kk_free(varg);
+  free(varg);
   (arg.action)(arg.arg);
   return 0;
 }
 
-static int pthread_create(pthread_t* thread, void* attr, void* (*action)(void*), void* arg) {
-  KK_UNUSED(attr);
-  kk_context_t* ctx = kk_get_context();
-  kk_thread_proc_arg_t* parg = (kk_thread_proc_arg_t*)kk_zalloc(kk_ssizeof(kk_thread_proc_arg_t), ctx);
+// create a thread where the stack is reserved with `stack_size` (or the default if 0);
+// if that fails, we fall back to the default stack size
+static int kk_thread_create_stack(pthread_t* thread, size_t stack_size, void* (*action)(void*), void* arg) {
+  // use plain malloc as this may be called before there is a context (see `kk_main_run`)
+  kk_thread_proc_arg_t* parg = (kk_thread_proc_arg_t*)calloc(1, sizeof(kk_thread_proc_arg_t));
+  if (parg == NULL) return ENOMEM;
   parg->action = action;
   parg->arg = arg;
   DWORD tid = 0;
-  *thread = CreateThread(NULL, 0, &kk_thread_proc, parg, 0, &tid);
-  return (*thread == NULL ? EINVAL : 0);
+  *thread = NULL;
+  if (stack_size > 0) {
+    *thread = CreateThread(NULL, stack_size, &kk_thread_proc, parg, STACK_SIZE_PARAM_IS_A_RESERVATION, &tid);
+  }
+  if (*thread == NULL) {
+    *thread = CreateThread(NULL, 0, &kk_thread_proc, parg, 0, &tid);
+  }
+  if (*thread == NULL) {
+    free(parg);
+    return EINVAL;
+  }
+  return 0;
 }
 
 
@@ -130,13 +150,170 @@ static int pthread_once(pthread_once_t* once, void (*init)(void)) {
 ---------------------------------------------------------------------------*/
 #else
 #include <pthread.h>
+#include <signal.h>
+#include <unistd.h>
 
 static void pthread_join_void(pthread_t thread) {
   pthread_join(thread, NULL);
 }
+
+// --------------------------------------
+// Stack overflow detection
+// A thread with a large stack runs its signal handlers on an alternate stack and
+// records the bounds of its stack, so a fault in the guard area below it can be
+// reported as a stack overflow instead of a plain segmentation fault.
+// (on windows, a stack overflow is already reported as such by the OS)
+
+#define KK_SIGNAL_STACK_SIZE  (64*1024)
+
+static kk_decl_thread uintptr_t kk_stack_top;        // (approximate) top of the stack of this thread
+static kk_decl_thread size_t    kk_stack_reserved;   // reserved stack size (or 0 if not detecting overflow)
+
+static struct sigaction kk_segv_prev;
+static struct sigaction kk_bus_prev;
+static pthread_once_t   kk_stack_overflow_once = PTHREAD_ONCE_INIT;
+
+static void kk_stack_overflow_handler(int sig, siginfo_t* info, void* uctx) {
+  KK_UNUSED(uctx);
+  const uintptr_t addr = (uintptr_t)info->si_addr;
+  const uintptr_t top  = kk_stack_top;
+  const size_t    size = kk_stack_reserved;
+  if (size > 0 && addr < top && addr + size + KK_STACK_GUARD_SIZE >= top) {
+    static const char msg[] = "error: stack overflow (use --kkstack=<n> to set the stack size in MiB)\n";
+    ssize_t n = write(2, msg, sizeof(msg) - 1);
+    KK_UNUSED(n);
+    struct sigaction dfl;
+    memset(&dfl, 0, sizeof(dfl));
+    dfl.sa_handler = SIG_DFL;
+    sigemptyset(&dfl.sa_mask);
+    sigaction(sig, &dfl, NULL);  // the fault is raised again on return and terminates the program
+  }
+  else {
+    // not an overflow: restore the previous handler and let it handle the fault on return
+    sigaction(sig, (sig == SIGSEGV ? &kk_segv_prev : &kk_bus_prev), NULL);
+  }
+}
+
+static void kk_stack_overflow_init(void) {
+  struct sigaction sa;
+  memset(&sa, 0, sizeof(sa));
+  sa.sa_sigaction = &kk_stack_overflow_handler;
+  sa.sa_flags = SA_SIGINFO | SA_ONSTACK;
+  sigemptyset(&sa.sa_mask);
+  sigaction(SIGSEGV, &sa, &kk_segv_prev);
+  sigaction(SIGBUS, &sa, &kk_bus_prev);      // macOS raises SIGBUS on a guard page
+}
+
+typedef struct kk_stack_thread_arg_s {
+  void* (*action)(void*);
+  void*   arg;
+  size_t  stack_size;
+} kk_stack_thread_arg_t;
+
+static void* kk_stack_thread_proc(void* varg) {
+  kk_stack_thread_arg_t sarg = *((kk_stack_thread_arg_t*)varg);
+  free(varg);
+  stack_t ss;
+  memset(&ss, 0, sizeof(ss));
+  ss.ss_sp = malloc(KK_SIGNAL_STACK_SIZE);
+  ss.ss_size = KK_SIGNAL_STACK_SIZE;
+  if (ss.ss_sp != NULL && sigaltstack(&ss, NULL) == 0) {
+    uint8_t top;
+    kk_stack_top = (uintptr_t)&top;
+    kk_stack_reserved = sarg.stack_size;
+  }
+  else {
+    free(ss.ss_sp);
+    ss.ss_sp = NULL;
+  }
+  void* result = (sarg.action)(sarg.arg);
+  if (ss.ss_sp != NULL) {
+    kk_stack_reserved = 0;
+    ss.ss_flags = SS_DISABLE;
+    sigaltstack(&ss, NULL);
+    free(ss.ss_sp);
+  }
+  return result;
+}
+
+// create a thread with a stack of `stack_size` (or the default if 0);
+// if that fails, we fall back to the default stack size (without overflow detection)
+static int kk_thread_create_stack(pthread_t* thread, size_t stack_size, void* (*action)(void*), void* arg) {
+  if (stack_size > 0) {
+    // use plain malloc as this may be called before there is a context (see `kk_main_run`)
+    kk_stack_thread_arg_t* sarg = (kk_stack_thread_arg_t*)malloc(sizeof(kk_stack_thread_arg_t));
+    pthread_attr_t attr;
+    if (sarg != NULL && pthread_attr_init(&attr) == 0) {
+      sarg->action = action;
+      sarg->arg = arg;
+      sarg->stack_size = stack_size;
+      pthread_once(&kk_stack_overflow_once, &kk_stack_overflow_init);
+      int err = pthread_attr_setstacksize(&attr, stack_size);
+      if (err == 0) {
+        pthread_attr_setguardsize(&attr, KK_STACK_GUARD_SIZE);
+        err = pthread_create(thread, &attr, &kk_stack_thread_proc, sarg);
+      }
+      pthread_attr_destroy(&attr);
+      if (err == 0) return 0;
+    }
+    free(sarg);
+    // fall through and try again with the default stack size
+  }
+  return pthread_create(thread, NULL, action, arg);
+}
 #endif
 
 
+/*---------------------------------------------------------------------------
+  Large stacks
+  The main entry and task group workers run on a large stack so deep
+  (non-tail) recursion does not overflow the (usually 1 to 8MiB) default stack.
+  The stack has a fixed size of 1GiB (64MiB on 32-bit systems) and does not grow;
+  it is only reserved as the OS commits pages on demand. A guard area at the end
+  turns an overflow into a fault that is reported as a stack overflow.
+---------------------------------------------------------------------------*/
+
+static size_t kk_stack_size = KK_STACK_SIZE_DEFAULT;
+
+typedef struct kk_main_arg_s {
+  int    argc;
+  char** argv;
+  int    (*main_fun)(int argc, char** argv);
+  int    result;
+} kk_main_arg_t;
+
+static void* kk_main_proc(void* varg) {
+  kk_main_arg_t* arg = (kk_main_arg_t*)varg;
+  arg->result = (arg->main_fun)(arg->argc, arg->argv);
+  kk_free_context();  // the context of this thread (as `kklib_done` runs on the initial thread)
+  return NULL;
+}
+
+// Run `main_fun` on a large stack. The stack size can be set in MiB using
+// the `--kkstack=<n>` option where `--kkstack=0` runs on the current stack.
+// `main_fun` should finalize the program itself (i.e. call `kk_main_end`) as
+// the context of the thread it runs on is freed when it returns.
+kk_decl_export int kk_main_run(int argc, char** argv, int (*main_fun)(int argc, char** argv)) {
+  for (int i = 1; i < argc && argv != NULL; i++) {
+    if (strncmp(argv[i], "--kkstack=", 10) == 0) {
+      kk_stack_size = (size_t)strtoull(argv[i] + 10, NULL, 10) * 1024 * 1024;
+    }
+    else if (strncmp(argv[i], "--kk", 4) != 0) {
+      break;
+    }
+  }
+  if (kk_stack_size > 0) {
+    kk_main_arg_t arg = { argc, argv, main_fun, 0 };
+    pthread_t thread;
+    if (kk_thread_create_stack(&thread, kk_stack_size, &kk_main_proc, &arg) == 0) {
+      pthread_join_void(thread);
+      return arg.result;
+    }
+  }
+  return main_fun(argc, argv);
+}
+
+
 /*---------------------------------------------------------------------------
   Promise
 ---------------------------------------------------------------------------*/
@@ -321,7 +498,8 @@ static kk_task_group_t* kk_task_group_alloc( kk_ssize_t thread_count, kk_context
   if (pthread_cond_init(&tg->tasks_available, NULL) != 0) goto err;
   if (pthread_mutex_init(&tg->tasks_lock, NULL) != 0) goto err;
   for (kk_ssize_t i = 0; i < tg->thread_count; i++) {
-    if (pthread_create(&tg->threads[i], NULL, &kk_task_group_worker, tg) != 0) {
+    // uses the default stack size if a large stack cannot be reserved
+    if (kk_thread_create_stack(&tg->threads[i], kk_stack_size, &kk_task_group_worker, tg) != 0) {
       goto err_threads;
     };
   }
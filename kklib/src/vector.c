@@ -34,9 +34,21 @@ void kk_vector_init_borrow(kk_vector_t _v, kk_ssize_t start, kk_box_t def, kk_co
 kk_vector_t kk_vector_realloc(kk_vector_t vec, kk_ssize_t newlen, kk_box_t def, kk_context_t* ctx) {
   kk_ssize_t len;
   kk_box_t* src = kk_vector_buf_borrow(vec, &len);
+  const kk_ssize_t n = (len > newlen ? newlen : len);
+  if (len > 0 && newlen > 0 && kk_datatype_is_unique(vec)) {
+    // fast path: resize in place and move the elements (instead of a dup and drop for each element)
+    for (kk_ssize_t i = newlen; i < len; i++) {
+      kk_box_drop(src[i], ctx);
+    }
+    kk_vector_large_t v = kk_vector_as_large_borrow(vec);
+    v = (kk_vector_large_t)kk_block_realloc(&v->_base._block, kk_vector_alloc_size(newlen), ctx);
+    v->_base.large_scan_fsize = kk_int_box(newlen + 1);
+    kk_vector_t vdest = kk_datatype_from_base(&v->_base);
+    kk_vector_init_borrow(vdest, n, def, ctx); // set extra entries to default value
+    return vdest;
+  }
   kk_box_t* dest;
   kk_vector_t vdest = kk_vector_alloc_uninit(newlen, &dest, ctx);
-  const kk_ssize_t n = (len > newlen ? newlen : len);
   for (kk_ssize_t i = 0; i < n; i++) {
     dest[i] = kk_box_dup(src[i]);
   }
@@ -50,6 +62,77 @@ kk_vector_t kk_vector_copy(kk_vector_t vec, kk_context_t* ctx) {
   return kk_vector_realloc(vec, len, kk_box_null, ctx);
 }
 
+// Append `x` at the end of `vec`; in place if `vec` is unique.
+kk_vector_t kk_vector_push(kk_vector_t vec, kk_box_t x, kk_context_t* ctx) {
+  const kk_ssize_t len = kk_vector_len_borrow(vec);
+  return kk_vector_realloc(vec, len + 1, x, ctx);
+}
+
+// Set element `count` of a vector that is used as a buffer with spare capacity beyond `count`.
+// The capacity grows by 1.5x when full so a sequence of pushes takes amortized constant time.
+kk_vector_t kk_vector_builder_push(kk_vector_t vec, kk_ssize_t count, kk_box_t x, kk_context_t* ctx) {
+  kk_ssize_t len = kk_vector_len_borrow(vec);
+  if (count >= len) {
+    const kk_ssize_t newlen = (len < 8 ? 8 : len + len/2);
+    vec = kk_vector_realloc(vec, newlen, kk_box_null, ctx);
+  }
+  else if (!kk_datatype_is_unique(vec)) {
+    vec = kk_vector_copy(vec, ctx);
+  }
+  kk_box_t* p = kk_vector_buf_borrow(vec, &len);
+  kk_assert(count < len);
+  kk_box_drop(p[count], ctx);
+  p[count] = x;
+  return vec;
+}
+
+// Set element `i` of `vec` to `x`; in place if `vec` is unique.
+kk_vector_t kk_vector_update(kk_vector_t vec, kk_ssize_t i, kk_box_t x, kk_context_t* ctx) {
+  if (!kk_datatype_is_unique(vec)) {
+    vec = kk_vector_copy(vec, ctx);
+  }
+  kk_ssize_t len;
+  kk_box_t* p = kk_vector_buf_borrow(vec, &len);
+  kk_assert(i >= 0 && i < len);
+  kk_box_drop(p[i], ctx);
+  p[i] = x;
+  return vec;
+}
+
+// Insert `x` before element `i` of `vec` (where `i` can be the length); in place if `vec` is unique.
+kk_vector_t kk_vector_insert(kk_vector_t vec, kk_ssize_t i, kk_box_t x, kk_context_t* ctx) {
+  const kk_ssize_t len = kk_vector_len_borrow(vec);
+  kk_assert(i >= 0 && i <= len);
+  vec = kk_vector_realloc(vec, len + 1, kk_box_null, ctx);
+  kk_box_t* p = kk_vector_buf_borrow(vec, NULL);
+  memmove(&p[i+1], &p[i], (size_t)(len - i)*sizeof(kk_box_t));
+  p[i] = x;
+  return vec;
+}
+
+// Remove element `i` of `vec`; in place if `vec` is unique.
+kk_vector_t kk_vector_remove(kk_vector_t vec, kk_ssize_t i, kk_context_t* ctx) {
+  kk_ssize_t len;
+  kk_box_t* p = kk_vector_buf_borrow(vec, &len);
+  kk_assert(i >= 0 && i < len);
+  if (kk_datatype_is_unique(vec)) {
+    kk_box_drop(p[i], ctx);
+    memmove(&p[i], &p[i+1], (size_t)(len - i - 1)*sizeof(kk_box_t));
+    p[len-1] = kk_box_null;
+    return kk_vector_realloc(vec, len - 1, kk_box_null, ctx);
+  }
+  kk_box_t* dest;
+  kk_vector_t vdest = kk_vector_alloc_uninit(len - 1, &dest, ctx);
+  for (kk_ssize_t j = 0; j < i; j++) {
+    dest[j] = kk_box_dup(p[j]);
+  }
+  for (kk_ssize_t j = i + 1; j < len; j++) {
+    dest[j-1] = kk_box_dup(p[j]);
+  }
+  kk_vector_drop(vec, ctx);
+  return vdest;
+}
+
 kk_unit_t kk_ref_vector_assign_borrow(kk_ref_t r, kk_integer_t idx, kk_box_t value, kk_context_t* ctx) {
   if (kk_likely(r->_block.header.thread_shared == 0)) {
     // fast path
@@ -72,4 +155,66 @@ kk_unit_t kk_ref_vector_assign_borrow(kk_ref_t r, kk_integer_t idx, kk_box_t val
     kk_unsupported_external("kk_ref_vector_assign with a thread-shared reference");
   }
   return kk_Unit;
-}
\ No newline at end of file
+}
+
+/*--------------------------------------------------------------------------------------------------
+  Unboxed arrays
+--------------------------------------------------------------------------------------------------*/
+
+static kk_ssize_t kk_array_alloc_size(kk_ssize_t length, kk_ssize_t elem_size) {
+  return (kk_ssizeof(struct kk_array_s) - kk_ssizeof(int64_t) + (length > 0 ? length*elem_size : 0));
+}
+
+kk_box_t kk_array_alloc(kk_ssize_t length, kk_ssize_t elem_size, void** buf, kk_context_t* ctx) {
+  if (length < 0) length = 0;
+  kk_array_t a = (kk_array_t)kk_block_alloc_any(kk_array_alloc_size(length, elem_size), 0, KK_TAG_ARRAY, ctx);
+  a->length = length;
+  a->elem_size = elem_size;
+  if (buf != NULL) *buf = &a->buf[0];
+  return kk_ptr_box(&a->_block);
+}
+
+// Resize an array; new elements are zero. This is done in-place if the array is unique.
+kk_box_t kk_array_realloc(kk_box_t a, kk_ssize_t newlen, kk_context_t* ctx) {
+  kk_array_t arr = kk_array_unbox_borrow(a);
+  const kk_ssize_t len = arr->length;
+  const kk_ssize_t elem_size = arr->elem_size;
+  if (newlen < 0) newlen = 0;
+  kk_array_t dest;
+  if (kk_block_is_unique(&arr->_block)) {
+    dest = (kk_array_t)kk_block_realloc(&arr->_block, kk_array_alloc_size(newlen, elem_size), ctx);
+  }
+  else {
+    void* buf;
+    dest = kk_array_unbox_borrow(kk_array_alloc(newlen, elem_size, &buf, ctx));
+    memcpy(buf, &arr->buf[0], (size_t)((len < newlen ? len : newlen) * elem_size));
+    kk_box_drop(a, ctx);
+  }
+  dest->length = newlen;
+  if (newlen > len) {
+    memset((uint8_t*)&dest->buf[0] + len*elem_size, 0, (size_t)((newlen - len) * elem_size));
+  }
+  return kk_ptr_box(&dest->_block);
+}
+
+kk_box_t kk_array_copy(kk_box_t a, kk_context_t* ctx) {
+  kk_array_t arr = kk_array_unbox_borrow(a);
+  void* buf;
+  kk_box_t b = kk_array_alloc(arr->length, arr->elem_size, &buf, ctx);
+  memcpy(buf, &arr->buf[0], (size_t)(arr->length * arr->elem_size));
+  kk_box_drop(a, ctx);
+  return b;
+}
+
+kk_box_t kk_ref_array_unique_borrow(kk_ref_t r, kk_context_t* ctx) {
+  if (kk_unlikely(r->_block.header.thread_shared != 0)) {
+    kk_unsupported_external("assignment to an array in a thread-shared reference");
+  }
+  kk_box_t a; a.box = kk_atomic_load_relaxed(&r->value);
+  if (kk_unlikely(!kk_block_is_unique(kk_ptr_unbox(a)))) {
+    // the old array is dropped by kk_ref_set_borrow
+    a = kk_array_copy(kk_box_dup(a), ctx);
+    kk_ref_set_borrow(r, a, ctx);
+  }
+  return a;
+}
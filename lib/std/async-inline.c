@@ -0,0 +1,23 @@
+/*---------------------------------------------------------------------------
+  Copyright 2021, Microsoft Research, Daan Leijen.
+
+  This is free software; you can redistribute it and/or modify it under the
+  terms of the Apache License, Version 2.0. A copy of the License can be
+  found in the LICENSE file at the root of this distribution.
+---------------------------------------------------------------------------*/
+
+static kk_unit_t kk_async_set_failure_exn( kk_std_core__exception exn, kk_context_t* ctx ) {
+  kk_async_set_failure(kk_std_core__exception_box(exn,ctx),ctx);
+  return kk_Unit;
+}
+
+static kk_std_core_types__maybe kk_async_take_failure_exn( kk_context_t* ctx ) {
+  kk_box_t exn = kk_async_take_failure(ctx);
+  if (kk_box_eq(exn,kk_box_null)) return kk_std_core_types__new_Nothing(ctx);
+                              else return kk_std_core_types__new_Just(exn,ctx);
+}
+
+static kk_std_core__error kk_async_errno_error( int32_t err, kk_context_t* ctx ) {
+  if (err != 0) return kk_error_from_errno(err,ctx);
+           else return kk_error_ok(kk_unit_box(kk_Unit),ctx);
+}
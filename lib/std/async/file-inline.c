@@ -0,0 +1,32 @@
+/*---------------------------------------------------------------------------
+  Copyright 2020-2021, Microsoft Research, Daan Leijen.
+
+  This is free software; you can redistribute it and/or modify it under the
+  terms of the Apache License, Version 2.0. A copy of the License can be
+  found in the LICENSE file at the root of this distribution.
+---------------------------------------------------------------------------*/
+
+static kk_std_core__error kk_async_file_open_error( kk_string_t path, bool write, kk_context_t* ctx ) {
+  kk_box_t file;
+  const int err = kk_async_file_open(path,write,&file,ctx);
+  if (err != 0) return kk_error_from_errno(err,ctx);
+           else return kk_error_ok(file,ctx);
+}
+
+static kk_std_core__error kk_async_file_size_error( kk_box_t file, kk_context_t* ctx ) {
+  int64_t size;
+  const int err = kk_async_file_size(file,&size,ctx);
+  if (err != 0) return kk_error_from_errno(err,ctx);
+           else return kk_error_ok(kk_integer_box(kk_integer_from_int64(size,ctx)),ctx);
+}
+
+static kk_std_core__error kk_async_file_close_error( kk_box_t file, kk_context_t* ctx ) {
+  const int err = kk_async_file_close(file,ctx);
+  if (err != 0) return kk_error_from_errno(err,ctx);
+           else return kk_error_ok(kk_unit_box(kk_Unit),ctx);
+}
+
+static kk_std_core__error kk_async_errno_error( int32_t err, kk_context_t* ctx ) {
+  if (err != 0) return kk_error_from_errno(err,ctx);
+           else return kk_error_ok(kk_unit_box(kk_Unit),ctx);
+}
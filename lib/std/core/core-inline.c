@@ -154,20 +154,9 @@ kk_integer_t kk_slice_count( kk_std_core__sslice sslice, kk_context_t* ctx ) {
 }
 
 kk_string_t kk_slice_to_string( kk_std_core__sslice  sslice, kk_context_t* ctx ) {
-  const uint8_t* start;
-  const uint8_t* end;
-  kk_sslice_start_end_borrow(sslice, &start, &end);
-  // is it the full string?
-  if (sslice.start == 0 && sslice.len == kk_string_len_borrow(sslice.str)) {
-    // TODO: drop sslice and dup sslice.str?
-    return sslice.str;
-  }
-  else {
-    // if not, we copy len bytes
-    kk_string_t s = kk_string_alloc_dupn_valid_utf8(sslice.len, start, ctx);
-    kk_std_core__sslice_drop(sslice,ctx);
-    return s;
-  }
+  // returns the string itself if the slice is the full string, and otherwise
+  // a view on the string (or a copy if the slice is short)
+  return kk_string_view(sslice.str, sslice.start, sslice.len, ctx);
 }
 
 kk_std_core__sslice kk_slice_first( kk_string_t str, kk_context_t* ctx ) {
@@ -221,13 +210,14 @@ struct kk_std_core_Sslice kk_slice_extend_borrow( struct kk_std_core_Sslice slic
   if (cnt==0 || (slice.len <= 0 && cnt<0)) return slice;
   const uint8_t* s0;
   const uint8_t* s1;
-  kk_sslice_start_end_borrow(slice,&s0,&s1);
+  const uint8_t* send;
+  kk_sslice_start_end_borrowx(slice,&s0,&s1,NULL,&send);
   const uint8_t* t  = s1;
   if (cnt >= 0) {
-    do {
+    while (cnt > 0 && t < send) {  // (the string may be a view that is not zero terminated)
       t = kk_utf8_next(t);
       cnt--;
-    } while (cnt > 0 && *t != 0);
+    }
   }
   else {  // cnt < 0
     const uint8_t* sstart = s0 - slice.start;
@@ -287,9 +277,13 @@ struct kk_std_core_Sslice kk_slice_advance_borrow( struct kk_std_core_Sslice sli
 
 /* Borrow iupto */
 struct kk_std_core_Sslice kk_slice_common_prefix_borrow( kk_string_t str1, kk_string_t str2, kk_integer_t iupto, kk_context_t* ctx ) {
-  const uint8_t* s1 = kk_string_buf_borrow(str1,NULL);
-  const uint8_t* s2 = kk_string_buf_borrow(str2,NULL);
+  kk_ssize_t len1;
+  kk_ssize_t len2;
+  const uint8_t* s1 = kk_string_buf_borrow(str1,&len1);
+  const uint8_t* s2 = kk_string_buf_borrow(str2,&len2);
   kk_ssize_t upto = kk_integer_clamp_ssize_t_borrow(iupto);
+  if (upto > len1) upto = len1;
+  if (upto > len2) upto = len2;
   kk_ssize_t count;
   for(count = 0; count < upto && *s1 != 0 && *s2 != 0; count++, s1++, s2++ ) {
     if (*s1 != *s2) break;
@@ -270,3 +270,15 @@ export function _vector_at( v, i ) {
   return x;
 }
 
+// Push on a vector builder that uses the first `i` elements of `v`. The array is only
+// extended in-place if no other builder sharing it has pushed at `i` already.
+export function _vector_builder_push( v, i, x ) {
+  if (v.length === i) {
+    v.push(x);
+    return v;
+  }
+  var w = v.slice(0,i);
+  w.push(x);
+  return w;
+}
+
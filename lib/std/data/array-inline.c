@@ -0,0 +1,21 @@
+/*---------------------------------------------------------------------------
+  Copyright 2020-2021, Microsoft Research, Daan Leijen.
+
+  This is free software; you can redistribute it and/or modify it under the
+  terms of the Apache License, Version 2.0. A copy of the License can be
+  found in the LICENSE file at the root of this distribution.
+---------------------------------------------------------------------------*/
+
+static kk_std_core__error kk_array_double_gather_error( kk_box_t a, kk_box_t idx, kk_context_t* ctx ) {
+  kk_box_t result;
+  const int err = kk_array_double_gather(a,idx,&result,ctx);
+  if (err != 0) return kk_error_from_errno(err,ctx);
+           else return kk_error_ok(result,ctx);
+}
+
+static kk_std_core__error kk_array_double_scatter_error( kk_box_t a, kk_box_t idx, kk_box_t v, kk_context_t* ctx ) {
+  kk_box_t result;
+  const int err = kk_array_double_scatter(a,idx,v,&result,ctx);
+  if (err != 0) return kk_error_from_errno(err,ctx);
+           else return kk_error_ok(result,ctx);
+}
@@ -0,0 +1,21 @@
+/*---------------------------------------------------------------------------
+  Copyright 2020-2021, Microsoft Research, Daan Leijen.
+
+  This is free software; you can redistribute it and/or modify it under the
+  terms of the Apache License, Version 2.0. A copy of the License can be
+  found in the LICENSE file at the root of this distribution.
+---------------------------------------------------------------------------*/
+
+function _iset_lowest_bit_index(bs) {
+  var x = BigInt.asUintN(64, bs);
+  var n = 0n;
+  while ((x & 1n) === 0n) { x >>= 1n; n++; }
+  return n;
+}
+
+function _iset_bit_count(bs) {
+  var x = BigInt.asUintN(64, bs);
+  var n = 0;
+  while (x !== 0n) { x &= (x - 1n); n++; }
+  return n;
+}
@@ -0,0 +1,13 @@
+/*---------------------------------------------------------------------------
+  Copyright 2020-2021, Microsoft Research, Daan Leijen.
+
+  This is free software; you can redistribute it and/or modify it under the
+  terms of the Apache License, Version 2.0. A copy of the License can be
+  found in the LICENSE file at the root of this distribution.
+---------------------------------------------------------------------------*/
+
+// Integers beyond 64 bits are clamped (and thus collide, which is correct but slow).
+static int32_t kk_map_int_hash( kk_integer_t i, kk_context_t* ctx ) {
+  const uint64_t h = kk_bits_mix64((uint64_t)kk_integer_clamp64(i,ctx));
+  return (int32_t)(uint32_t)(h ^ (h >> 32));
+}
@@ -0,0 +1,47 @@
+/*---------------------------------------------------------------------------
+  Copyright 2020-2021, Microsoft Research, Daan Leijen.
+
+  This is free software; you can redistribute it and/or modify it under the
+  terms of the Apache License, Version 2.0. A copy of the License can be
+  found in the LICENSE file at the root of this distribution.
+---------------------------------------------------------------------------*/
+
+function _bits_count32(x) {
+  x = x - ((x >>> 1) & 0x55555555);
+  x = (x & 0x33333333) + ((x >>> 2) & 0x33333333);
+  x = (x + (x >>> 4)) & 0x0F0F0F0F;
+  return ((x * 0x01010101) >>> 24);
+}
+
+function _vector_update(v,i,x) {
+  var w = v.slice();
+  w[i] = x;
+  return w;
+}
+
+function _vector_insert(v,i,x) {
+  var w = v.slice();
+  w.splice(i,0,x);
+  return w;
+}
+
+function _vector_remove(v,i) {
+  var w = v.slice();
+  w.splice(i,1);
+  return w;
+}
+
+function _int_hash(i) {
+  var h = Number(i) | 0;
+  h = Math.imul(h ^ (h >>> 16), 0x45D9F3B);
+  h = Math.imul(h ^ (h >>> 16), 0x45D9F3B);
+  return (h ^ (h >>> 16)) | 0;
+}
+
+function _string_hash(s) {
+  var h = 0x811C9DC5 | 0;
+  for (var i = 0; i < s.length; i++) {
+    h = Math.imul(h ^ s.charCodeAt(i), 0x01000193);
+  }
+  return h | 0;
+}
@@ -26,3 +26,20 @@ static kk_std_core__error kk_os_list_directory_prim( kk_string_t dir, kk_context
   if (err != 0) return kk_error_from_errno(err,ctx);
            else return kk_error_ok(kk_vector_box(contents,ctx),ctx);
 }
+
+static kk_std_core__error kk_os_walk_open_error( kk_string_t dir, kk_integer_t max_depth, kk_context_t* ctx ) {
+  int depth = kk_integer_clamp32_borrow(max_depth);
+  kk_integer_drop(max_depth, ctx);
+  kk_box_t walker;
+  const int err = kk_os_walk_open(dir,depth,&walker,ctx);
+  if (err != 0) return kk_error_from_errno(err,ctx);
+           else return kk_error_ok(walker,ctx);
+}
+
+static kk_std_core__error kk_os_walk_next_error( kk_box_t walker, kk_context_t* ctx ) {
+  kk_vector_t paths;
+  kk_string_t kinds;
+  const int err = kk_os_walk_next(walker,&paths,&kinds,ctx);
+  if (err != 0) return kk_error_from_errno(err,ctx);
+           else return kk_error_ok(kk_std_core_types__tuple2__box(kk_std_core_types__new_dash__lp__comma__rp_(kk_vector_box(paths,ctx),kk_string_box(kinds),ctx),ctx),ctx);
+}
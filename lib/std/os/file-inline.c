@@ -18,3 +18,45 @@ static kk_std_core__error kk_os_write_text_file_error( kk_string_t path, kk_stri
   if (err != 0) return kk_error_from_errno(err,ctx);
            else return kk_error_ok(kk_unit_box(kk_Unit),ctx);
 }
+
+static kk_std_core__error kk_os_file_open_error( kk_string_t path, bool write, bool append, kk_ssize_t bufsize, kk_context_t* ctx ) {
+  kk_box_t file;
+  const int err = kk_os_file_open(path,write,append,bufsize,&file,ctx);
+  if (err != 0) return kk_error_from_errno(err,ctx);
+           else return kk_error_ok(file,ctx);
+}
+
+static kk_std_core__error kk_os_file_read_chunk_error( kk_box_t file, kk_context_t* ctx ) {
+  kk_string_t chunk;
+  const int err = kk_os_file_read_chunk(file,&chunk,ctx);
+  if (err != 0) return kk_error_from_errno(err,ctx);
+  kk_std_core_types__maybe res = (kk_string_is_empty_borrow(chunk) ? kk_std_core_types__new_Nothing(ctx) : kk_std_core_types__new_Just(kk_string_box(chunk),ctx));
+  return kk_error_ok(kk_std_core_types__maybe_box(res,ctx),ctx);
+}
+
+static kk_std_core__error kk_os_file_read_line_error( kk_box_t file, kk_context_t* ctx ) {
+  kk_string_t line;
+  bool eof;
+  const int err = kk_os_file_read_line(file,&line,&eof,ctx);
+  if (err != 0) return kk_error_from_errno(err,ctx);
+  kk_std_core_types__maybe res = (eof ? kk_std_core_types__new_Nothing(ctx) : kk_std_core_types__new_Just(kk_string_box(line),ctx));
+  return kk_error_ok(kk_std_core_types__maybe_box(res,ctx),ctx);
+}
+
+static kk_std_core__error kk_os_file_write_error( kk_box_t file, kk_string_t s, kk_context_t* ctx ) {
+  const int err = kk_os_file_write(file,s,ctx);
+  if (err != 0) return kk_error_from_errno(err,ctx);
+           else return kk_error_ok(kk_unit_box(kk_Unit),ctx);
+}
+
+static kk_std_core__error kk_os_file_flush_error( kk_box_t file, kk_context_t* ctx ) {
+  const int err = kk_os_file_flush(file,ctx);
+  if (err != 0) return kk_error_from_errno(err,ctx);
+           else return kk_error_ok(kk_unit_box(kk_Unit),ctx);
+}
+
+static kk_std_core__error kk_os_file_close_error( kk_box_t file, kk_context_t* ctx ) {
+  const int err = kk_os_file_close(file,ctx);
+  if (err != 0) return kk_error_from_errno(err,ctx);
+           else return kk_error_ok(kk_unit_box(kk_Unit),ctx);
+}
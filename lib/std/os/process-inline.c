@@ -17,3 +17,30 @@ static kk_integer_t kk_os_run_system_prim( kk_string_t cmd, kk_context_t* ctx )
   const int exitcode = kk_os_run_system(cmd,ctx);
   return kk_integer_from_int(exitcode,ctx);
 }
+
+static kk_std_core__error kk_os_process_spawn_error( kk_string_t cmd, bool pipe_stdin, bool pipe_stderr, kk_context_t* ctx ) {
+  kk_box_t proc;
+  const int err = kk_os_process_spawn(cmd,pipe_stdin,pipe_stderr,&proc,ctx);
+  if (err != 0) return kk_error_from_errno(err,ctx);
+           else return kk_error_ok(proc,ctx);
+}
+
+static kk_std_core__error kk_os_process_next_error( kk_box_t proc, kk_context_t* ctx ) {
+  int event;
+  const int err = kk_os_process_next(proc,&event,ctx);
+  if (err != 0) return kk_error_from_errno(err,ctx);
+           else return kk_error_ok(kk_integer_box(kk_integer_from_small(event)),ctx);
+}
+
+static kk_std_core__error kk_os_process_write_error( kk_box_t proc, kk_string_t s, kk_context_t* ctx ) {
+  const int err = kk_os_process_write(proc,s,ctx);
+  if (err != 0) return kk_error_from_errno(err,ctx);
+           else return kk_error_ok(kk_unit_box(kk_Unit),ctx);
+}
+
+static kk_std_core__error kk_os_process_wait_error( kk_box_t proc, kk_context_t* ctx ) {
+  int exitcode;
+  const int err = kk_os_process_wait(proc,&exitcode,ctx);
+  if (err != 0) return kk_error_from_errno(err,ctx);
+           else return kk_error_ok(kk_integer_box(kk_integer_from_int(exitcode,ctx)),ctx);
+}
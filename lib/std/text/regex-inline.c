@@ -80,7 +80,7 @@ static kk_box_t kk_regex_create( kk_string_t pat, bool ignore_case, bool multi_l
   uint32_t   options = KK_REGEX_OPTIONS;
   if (ignore_case) options |= PCRE2_CASELESS;
   if (multi_line)  options |= PCRE2_MULTILINE;
-  pcre2_code* re = pcre2_compile( cpat, PCRE2_ZERO_TERMINATED, options, &errnum, &errofs, cmp_ctx);
+  pcre2_code* re = pcre2_compile( cpat, (PCRE2_SIZE)len, options, &errnum, &errofs, cmp_ctx);
   //kk_info_message( "create regex: err:%i, at %p\n", (re==NULL ? 0 : errnum), re );
   kk_string_drop(pat,ctx);
   return kk_cptr_raw_box( &kk_regex_free, re, ctx );
@@ -211,20 +211,29 @@ genMain :: Name -> Maybe (Name,Bool) -> Asm ()
 genMain progName Nothing = return ()
 genMain progName (Just (name,_))
   = emitToC $
-    text "\n// main exit\nstatic void _kk_main_exit(void)" <+> block (vcat [
+    text "\n// main exit: only finalizes if the program exits before the main entry returns;" <->
+    text "// otherwise the main entry already finalized on its own thread (see `kk_main_run`)" <->
+    text "static bool _kk_main_finished = false;" <->
+    text "static void _kk_main_exit(void)" <+> block (vcat [
+            text "if (_kk_main_finished) return;",
             text "kk_context_t* _ctx = kk_get_context();",
             ppName (qualify progName (newName ".done")) <.> parens (text "_ctx") <.> semi
           ]) 
     <->
-    text "\n// main entry\nint main(int argc, char** argv)" <+> block (vcat [
+    text "\n// main entry\nstatic int _kk_main(int argc, char** argv)" <+> block (vcat [
         text "kk_context_t* _ctx = kk_main_start(argc, argv);"
       , ppName (qualify progName (newName ".init")) <.> parens (text "_ctx") <.> semi
       , text "atexit(&_kk_main_exit);"
       , ppName name <.> parens (text "_ctx") <.> semi
       , ppName (qualify progName (newName ".done")) <.> parens (text "_ctx") <.> semi
       , text "kk_main_end(_ctx);"
+      , text "_kk_main_finished = true;"
       , text "return 0;"
       ])
+    <->
+    text "\n// run the main entry on a large stack\nint main(int argc, char** argv)" <+> block (
+        text "return kk_main_run(argc, argv, &_kk_main);"
+      )
 
 ---------------------------------------------------------------------------------
 -- Generate C statements for value definitions
@@ -729,6 +738,11 @@ genBox name info dataRepr
                         (isoName,isoTp)   = (head (conInfoParams conInfo))
                     in text "return" <+> genBoxCall "box" False isoTp (text "_x." <.> ppName (unqualify isoName)) <.> semi
         _ -> case dataInfoDef info of
+               DataDefValue raw 0 | raw > 0 && not (hasTagField dataRepr)
+                  -> -- no scan fields: small ones can be stored in the box itself
+                     vcat [ text "kk_box_t _box;"
+                          , text "kk_valuetype_box_small" <.> arguments [ppName name, text "_box", text "_x"] <.> semi
+                          , text "return _box;" ]
                DataDefValue raw scancount
                   -> let -- extra = if (isDataStructLike dataRepr) then 1 else 0  -- adjust scan count for added "tag_t" members in structs with multiple constructors
                          docScanCount = if (hasTagField dataRepr)
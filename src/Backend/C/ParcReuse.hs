@@ -230,22 +230,39 @@ ruTryReuseCon cname repr conApp
        let (size,_) = constructorSizeOf platform newtypes cname repr
        available <- getAvailable
        -- ruTrace $ "try reuse: " ++ show (getName cname) ++ ": " ++ show size
-       case M.lookup size available of
-         Just (rinfo0:rinfos0)
-           -> do let (rinfo,rinfos) = pick cname rinfo0 rinfos0
-                 setAvailable (M.insert size rinfos available)
+       case pickAvailable cname size available of
+         Just (rinfo,available')
+           -> do setAvailable available'
                  markReused (reuseName rinfo)
                  return (genAllocAt rinfo conApp)
          _ -> return conApp
+
+-- Pick a reuse token from the available ones for an allocation of `size` bytes.
+-- We prefer a token of the same size, but otherwise use the smallest larger one:
+-- the allocation always fits in the usable size of a larger block. (Specialized
+-- reuse in `ParcReuseSpec` only applies to the same constructor so it is not
+-- affected by the size difference.)
+pickAvailable :: TName -> Int -> Available -> Maybe (ReuseInfo, Available)
+pickAvailable cname size available  | size <= 0  -- value types and singletons are not allocated
+  = Nothing
+pickAvailable cname size available
+  = case [(sz,rinfo,rinfos) | (sz,rinfo:rinfos) <- candidates] of
+      ((sz,rinfo0,rinfos0):_) -> let (rinfo,rinfos) = pick rinfo0 rinfos0
+                                 in Just (rinfo, M.insert sz rinfos available)
+      _ -> Nothing
   where
+    candidates
+      = let (_,exact,larger) = M.splitLookup size available
+        in maybeToList (fmap (\rinfos -> (size,rinfos)) exact) ++ M.toAscList larger
+
     -- pick a good match: for now we prefer the same constructor
     -- todo: match also common fields/arguments to help specialized reuse
-    pick cname rinfo []
+    pick rinfo []
       = (rinfo,[])
-    pick cname rinfo@(ReuseInfo name (PatCon{patConName})) rinfos  | patConName == cname
+    pick rinfo@(ReuseInfo name (PatCon{patConName})) rinfos  | patConName == cname
       = (rinfo,rinfos)
-    pick cname rinfo (rinfo':rinfos)
-      = let (r,rs) = pick cname rinfo' rinfos in (r,rinfo:rs)
+    pick rinfo (rinfo':rinfos)
+      = let (r,rs) = pick rinfo' rinfos in (r,rinfo:rs)
 
 ruTryReuseNameIn :: Bool -> TName -> Expr -> Reuse (Expr, Maybe Def)
 ruTryReuseNameIn shouldGenDrop tname expr
@@ -13,7 +13,7 @@ module Common.File(
                   -- * System
                     getEnvPaths, getEnvVar
                   , searchPaths, searchPathsSuffixes, searchPathsEx
-                  , runSystem, runSystemRaw, runCmd
+                  , runSystem, runSystemRaw, runCmd, runCmdRead
                   , getInstallDir, getProgramPath
 
                   -- * Strings
@@ -47,7 +47,7 @@ import Platform.Config  ( pathSep, pathDelimiter, sourceExtension )
 import qualified Platform.Runtime as B ( copyBinaryFile, exCatch )
 import Common.Failure   ( raiseIO, catchIO )
 
-import System.Process   ( system, rawSystem )
+import System.Process   ( system, rawSystem, readProcessWithExitCode )
 import System.Exit      ( ExitCode(..) )
 import System.Environment ( getEnvironment, getExecutablePath )
 import System.Directory ( doesFileExist, doesDirectoryExist
@@ -238,6 +238,12 @@ runCmd cmd args
           ExitFailure i -> raiseIO ("command failed (exit code " ++ show i ++ ")") -- \n  " ++ concat (intersperse " " (cmd:args)))
           ExitSuccess   -> return ()
 
+-- | Run a command and return whether it succeeded together with its standard output and error.
+runCmdRead :: String -> [String] -> IO (Bool,String,String)
+runCmdRead cmd args
+  = do (exitCode,out,err) <- readProcessWithExitCode cmd args ""
+       return (exitCode == ExitSuccess, out, err)
+
 -- | Compare two file modification times (uses 0 for non-existing files)
 fileTimeCompare :: FilePath -> FilePath -> IO Ordering
 fileTimeCompare fname1 fname2
@@ -31,7 +31,18 @@ module Compiler.Compile( -- * Compile
 import Lib.Trace              ( trace )
 import Data.Char              ( isAlphaNum, toLower, isSpace )
 
-import System.Directory       ( createDirectoryIfMissing, canonicalizePath, getCurrentDirectory, doesDirectoryExist )
+import System.Directory       ( createDirectoryIfMissing, canonicalizePath, getCurrentDirectory, doesDirectoryExist, removeFile )
+import System.IO              ( hPutStr, hFlush, stdout, stderr )
+import Control.Concurrent     ( forkIO )
+import Control.Concurrent.MVar
+import Control.Concurrent.QSem
+import qualified Control.Exception as Ex
+import GHC.Conc               ( getNumProcessors )
+import Data.Bits              ( xor )
+import Data.Word              ( Word64 )
+import qualified Numeric      ( showHex )
+import qualified Data.ByteString as B
+import Platform.Runtime       ( unsafePerformIO, finally )
 import Data.Maybe             ( catMaybes )
 import Data.List              ( isPrefixOf, intersperse )
 import qualified Data.Set as S
@@ -64,6 +75,7 @@ import Core.Monadic           ( monTransform )
 import Core.MonadicLift       ( monadicLift )
 import Core.Inlines           ( inlinesExtends, extractInlineDefs, inlinesMerge, inlinesToList, inlinesFilter, inlinesNew )
 import Core.Borrowed          ( Borrowed )
+import Core.BorrowInference   ( borrowInference )
 import Core.Inline            ( inlineDefs )
 import Core.Specialize
 
@@ -303,10 +315,12 @@ compileFile :: Terminal -> Flags -> Modules -> CompileTarget () -> FilePath -> I
 compileFile term flags modules compileTarget fpath
   = runIOErr $
     do mbP <- liftIO $ searchSourceFile flags "" fpath
-       case mbP of
-         Nothing -> liftError $ errorMsg (errorFileNotFound flags fpath)
-         Just (root,stem)
-           -> compileProgramFromFile term flags modules compileTarget root stem
+       loaded <- case mbP of
+                   Nothing -> liftError $ errorMsg (errorFileNotFound flags fpath)
+                   Just (root,stem)
+                     -> compileProgramFromFile term flags modules compileTarget root stem
+       liftIO $ compilerCatch "c compilation" term () ccompileWait
+       return loaded
 
 -- | Make a file path relative to a set of given paths: return the (maximal) root and stem
 -- if it is not relative to the paths, return dirname/notdir
@@ -324,6 +338,7 @@ compileModule term flags modules name  -- todo: take force into account
   = runIOErr $
     do let imp = ImpProgram (Import name name rangeNull Private)
        loaded <- resolveImports name term flags "" initialLoaded{ loadedModules = modules } [imp]
+       liftIO $ compilerCatch "c compilation" term () ccompileWait
        -- trace ("compileModule: loaded modules: " ++ show (map modName (loadedModules loaded))) $ return ()
        case filter (\m -> modName m == name) (loadedModules loaded) of
          (mod:_) -> return loaded{ loadedModule = mod }
@@ -403,7 +418,8 @@ compileProgram' term flags modules compileTarget fname program
                                           (imp:_) -> importVis imp -- TODO: get max
                               in if (modName mod == name) then []
                                   else [Core.Import (modName mod) (modPackagePath mod) vis (Core.coreProgDoc (modCore mod))]
-       (loaded2a, coreDoc) <- liftError $ typeCheck loaded1 flags 0 coreImports program
+       (loaded2a, coreDoc, specReport) <- liftError $ typeCheck loaded1 flags 0 coreImports program
+       liftIO $ mapM_ (if (showSpecialize flags) then termDoc term . text else termPhase term) specReport
        when (showCore flags) $
          liftIO (termDoc term (vcat [
            text "-------------------------",
@@ -448,7 +464,7 @@ compileProgram' term flags modules compileTarget fname program
                                                                       ) False r) [] r
                                                 defMain    = Def (ValueBinder (unqualify mainName2) () (Lam [] (f expression) r) r r)  r Public (DefFun []) InlineNever  ""
                                                 program2   = programAddDefs program [] [defMain]
-                                            in do (loaded3,_) <- typeCheck loaded1 flags 0 coreImports program2
+                                            in do (loaded3,_,_) <- typeCheck loaded1 flags 0 coreImports program2
                                                   return (Executable mainName2 tp, loaded3) -- TODO: refine the type of main2
                                []   -> errorMsg (ErrorGeneral rangeNull (text "the type of 'main' must be a function without arguments" <->
                                                                                       table [(text "expected type", ppType (prettyEnvFromFlags flags) mainType)
@@ -778,7 +794,7 @@ searchIncludeIface flags currentDir name
 {---------------------------------------------------------------
 
 ---------------------------------------------------------------}
-typeCheck :: Loaded -> Flags -> Int -> [Core.Import] -> UserProgram -> Error (Loaded,Doc)
+typeCheck :: Loaded -> Flags -> Int -> [Core.Import] -> UserProgram -> Error (Loaded,Doc,[String])
 typeCheck loaded flags line coreImports program
   = do -- static checks
        -- program1 <- {- mergeSignatures (colorSchemeFromFlags flags) -} (implicitPromotion program)
@@ -813,7 +829,7 @@ typeCheck loaded flags line coreImports program
        addWarnings warnings (inferCheck loaded1 flags line coreImports program2 )
 
 
-inferCheck :: Loaded -> Flags -> Int -> [Core.Import] -> UserProgram -> Error (Loaded,Doc)
+inferCheck :: Loaded -> Flags -> Int -> [Core.Import] -> UserProgram -> Error (Loaded,Doc,[String])
 inferCheck loaded0 flags line coreImports program
   = Core.runCorePhase (loadedUnique loaded0) $
     do -- kind inference
@@ -899,8 +915,8 @@ inferCheck loaded0 flags line coreImports program
                          Core.withCoreDefs (\defs -> extractSpecializeDefs defs)
        -- traceM ("Spec defs:\n" ++ unlines (map show specializeDefs))
        
-       when (optSpecialize flags) $
-         specialize (inlinesExtends specializeDefs (loadedInlines loaded))
+       specReport <- if (not (optSpecialize flags)) then return []
+                       else specialize (inlinesExtends specializeDefs (loadedInlines loaded))
        -- traceDefGroups "specialized"
 
        -- simplifyDupN
@@ -947,6 +963,10 @@ inferCheck loaded0 flags line coreImports program
        -- final simplification
        simplifyDupN
        checkCoreDefs "final" 
+
+       -- infer borrowed parameters; these are exported in the interface so importing modules can use them
+       when (parcBorrowInference flags && target flags == C) $
+         borrowInference (loadedBorrowed loaded)
        -- traceDefGroups "simplify final"
 
        -- Assemble core program and return
@@ -977,7 +997,7 @@ inferCheck loaded0 flags line coreImports program
            coreDoc = Core.Pretty.prettyCore (prettyEnvFromFlags flags){ coreIface = False, coreShowDef = True } C [] 
                        (coreProgram{ Core.coreProgDefs = coreDefsInlined })
 
-       return (loadedFinal, coreDoc)
+       return (loadedFinal, coreDoc, specReport)
 
 modulePath mod
   = let path = maybe "" (sourceName . programSource) (modProgram mod)
@@ -1213,8 +1233,8 @@ codeGenC sourceFile newtypes borrowed0 unique0 term flags modules compileTarget
           clibs    = clibsFromCore flags bcore 
       mapM_ (copyCLibrary term flags cc) eimports
 
-      -- compile      
-      ccompile term flags cc outBase [outC] 
+      -- compile (possibly concurrently)
+      ccompileModule term flags cc outBase [outC] 
 
       -- compile and link?
       case mbEntry of
@@ -1228,6 +1248,9 @@ codeGenC sourceFile newtypes borrowed0 unique0 term flags modules compileTarget
                 mainName   = if null (exeName flags) then mainModName else exeName flags
                 mainExe    = outName flags mainName
 
+            -- wait for the compilation of all modules
+            ccompileWait
+
             -- build kklib for the specified build variant
             -- cmakeLib term flags cc "kklib" (ccLibFile cc "kklib") cmakeGeneratorFlag
             kklibObj <- kklibBuild term flags cc "kklib" (ccObjFile cc "kklib")
@@ -1272,23 +1295,150 @@ codeGenC sourceFile newtypes borrowed0 unique0 term flags modules compileTarget
 
 ccompile :: Terminal -> Flags -> CC -> FilePath -> [FilePath] -> IO ()
 ccompile term flags cc ctargetObj csources 
-  = do let cmdline = concat $
-                      [ [ccPath cc]
-                      , ccFlags cc
-                      , ccFlagsWarn cc
-                      , ccFlagsBuildFromFlags cc flags
-                      , ccFlagsCompile cc
-                      , ccIncludeDir cc (localShareDir flags ++ "/kklib/include")
-                      ]
-                      ++
-                      map (ccIncludeDir cc) (ccompIncludeDirs flags)
-                      ++
-                      map (ccAddDef cc) (ccompDefs flags)
-                      ++
-                      [ ccTargetObj cc (notext ctargetObj)
-                      , csources
-                      ]
-       runCommand term flags cmdline
+  = runCommand term flags (ccompileCommand flags cc ctargetObj csources)
+
+ccompileCommand :: Flags -> CC -> FilePath -> [FilePath] -> [String]
+ccompileCommand flags cc ctargetObj csources 
+  = concat $
+    [ [ccPath cc]
+    , ccFlags cc
+    , ccFlagsWarn cc
+    , ccFlagsBuildFromFlags cc flags
+    , ccFlagsCompile cc
+    , ccIncludeDir cc (localShareDir flags ++ "/kklib/include")
+    ]
+    ++
+    map (ccIncludeDir cc) (ccompIncludeDirs flags)
+    ++
+    map (ccAddDef cc) (ccompDefs flags)
+    ++
+    [ ccTargetObj cc (notext ctargetObj)
+    , csources
+    ]
+
+
+{---------------------------------------------------------------
+  Compile generated C modules.
+  With `-j<n>` (n > 1, or 0 for the number of cores) the C compiler runs
+  concurrently on the generated modules. Modules are generated in dependency order and a module only needs the headers
+  of its imports, so each compilation is started as soon as its module is generated
+  and we only wait for all pending compilations before linking (`ccompileWait`).
+  The output of concurrent compilations is buffered per module so diagnostics do not interleave.
+  Independent of `-j`, a module whose C code is unchanged is not recompiled (see `ccompileCached`);
+  use `--no-cchash` to always invoke the C compiler.
+---------------------------------------------------------------}
+
+ccompileModule :: Terminal -> Flags -> CC -> FilePath -> [FilePath] -> IO ()
+ccompileModule term flags cc ctargetObj csources
+  | ccompJobs flags == 1 || ccompJobs flags < 0
+    = ccompileCached term flags cc False ctargetObj csources
+  | otherwise
+    = do n    <- if (ccompJobs flags == 0) then getNumProcessors else return (ccompJobs flags)
+         sem  <- modifyMVar cjobs $ \(mbsem,pending) ->
+                   case mbsem of
+                     Just sem -> return ((mbsem,pending),sem)
+                     Nothing  -> do sem <- newQSem n
+                                    return ((Just sem,pending),sem)
+         done <- newEmptyMVar
+         waitQSem sem
+         forkIO $ do res <- Ex.try (ccompileCached term flags cc True ctargetObj csources) `finally` signalQSem sem
+                     putMVar done res
+         modifyMVar_ cjobs (\(mbsem,pending) -> return (mbsem,done:pending))
+
+-- | Wait for all pending C compilations and re-raise the first failure (if any)
+ccompileWait :: IO ()
+ccompileWait
+  = do pending <- modifyMVar cjobs (\(mbsem,pending) -> return ((mbsem,[]),pending))
+       results <- mapM takeMVar (reverse pending)
+       case [err | Left err <- results] of
+         (err:_) -> Ex.throwIO (err :: Ex.SomeException)
+         []      -> return ()
+
+{-# NOINLINE cjobs #-}
+cjobs :: MVar (Maybe QSem, [MVar (Either Ex.SomeException ())])
+cjobs = unsafePerformIO (newMVar (Nothing,[]))
+
+-- | Compile unless the object file is up-to-date: we keep a hash of the C sources, the
+-- included headers, the command line, and the C compiler version next to the object file.
+-- This way a module whose generated C is unchanged is not recompiled (even if it was regenerated).
+-- If `buffered` is true, the compiler output is written at once when it finishes.
+ccompileCached :: Terminal -> Flags -> CC -> Bool -> FilePath -> [FilePath] -> IO ()
+ccompileCached term flags cc buffered ctargetObj csources
+  = do let cmdline  = ccompileCommand flags cc ctargetObj csources
+           objFile  = notext ctargetObj ++ objExtension
+           hashFile = objFile ++ ".hash"
+           compile  = if buffered then runCommandBuffered term flags cmdline
+                                  else runCommand term flags cmdline
+       oldHash  <- do exist <- doesFileExist hashFile
+                      if (exist) then readHashFile hashFile else return ""
+       if (not (ccompCache flags))
+        then do when (not (null oldHash)) $ removeFile hashFile
+                compile
+        else do hash     <- ccompileHash flags cc cmdline csources
+                objExist <- doesFileExist objFile
+                if (objExist && hash == oldHash && not (rebuild flags))
+                  then termPhase term ("c compile up-to-date: " ++ objFile)
+                  else do when (not (null oldHash)) $ removeFile hashFile
+                          compile
+                          writeFile hashFile hash
+  where
+    readHashFile fname
+      = do content <- B.readFile fname   -- strict so the file is closed before we may rewrite it
+           return (map (toEnum . fromEnum) (B.unpack content))
+
+ccompileHash :: Flags -> CC -> [String] -> [FilePath] -> IO String
+ccompileHash flags cc cmdline csources
+  = do let kklibHeader = localShareDir flags ++ "/kklib/include/kklib.h"
+       fnames   <- includes S.empty (csources ++ [kklibHeader])
+       contents <- mapM B.readFile fnames
+       ccversion <- ccompilerVersion cc
+       let h0 = fnvBytes fnvInit (B.pack (map (fromIntegral . fromEnum) (unwords cmdline ++ "\n" ++ ccversion)))
+       return (Numeric.showHex (foldl fnvBytes h0 contents) "")
+  where
+    -- transitively find all existing files included with `#include "..."`
+    includes :: S.Set FilePath -> [FilePath] -> IO [FilePath]
+    includes visited []  = return []
+    includes visited (fname:fnames)
+      | S.member fname visited = includes visited fnames
+      | otherwise
+        = do exist <- doesFileExist fname
+             if (not exist) then includes (S.insert fname visited) fnames
+              else do content <- B.readFile fname
+                      let incs = [if (isAbsolute inc) then inc else joinPath (dirname fname) inc
+                                 | line <- lines (map (toEnum . fromEnum) (B.unpack content))
+                                 , Just inc <- [quotedInclude line]]
+                      rest <- includes (S.insert fname visited) (incs ++ fnames)
+                      return (fname : rest)
+
+    quotedInclude line
+      = case words line of
+          ("#include":('"':inc):_) | not (null inc) && last inc == '"' -> Just (init inc)
+          _ -> Nothing
+
+    fnvInit :: Word64
+    fnvInit = 14695981039346656037
+
+    fnvBytes :: Word64 -> B.ByteString -> Word64
+    fnvBytes h bs = B.foldl' (\acc w -> (acc `xor` fromIntegral w) * 1099511628211) h bs
+
+-- | The version banner of the C compiler so objects are recompiled when the compiler is upgraded.
+-- It is computed once per compiler; if it cannot be determined we use the empty string.
+ccompilerVersion :: CC -> IO String
+ccompilerVersion cc
+  = modifyMVar ccversions $ \versions ->
+    case lookup (ccPath cc) versions of
+      Just v  -> return (versions,v)
+      Nothing -> do let isMsvc = ccName cc `startsWith` "cl" && not (ccName cc `startsWith` "clang")
+                        args   = if isMsvc then [] else ["--version"]   -- msvc prints its banner without arguments
+                    res <- Ex.try (runCmdRead (ccPath cc) args) :: IO (Either Ex.SomeException (Bool,String,String))
+                    let v = case res of
+                              Right (_,out,err) -> out ++ err
+                              Left _            -> ""
+                    length v `seq` return ((ccPath cc,v):versions, v)
+
+{-# NOINLINE ccversions #-}
+ccversions :: MVar [(FilePath,String)]
+ccversions = unsafePerformIO (newMVar [])
 
 
 copyCLibrary :: Terminal -> Flags -> CC -> [(String,String)] -> IO ()
@@ -1541,6 +1691,26 @@ runCommand term flags cargs@(cmd:args)
         `catchIO` (\msg -> raiseIO ("error  : " ++ msg ++ "\ncommand: " ++ command ))
 
 
+-- | Like `runCommand` but the output of the command is buffered and written at once
+-- when the command finishes, so the output of concurrent commands does not interleave.
+runCommandBuffered :: Terminal -> Flags -> [String] -> IO ()
+runCommandBuffered term flags cargs@(cmd:args)
+  = do let command = unwords (cmd : map showArg args)
+           showArg arg = if (' ' `elem` arg) then show arg else arg
+       when (verbose flags >= 2) $
+         termPhase term ("command> " ++ command)
+       (ok,out,err) <- runCmdRead cmd (filter (not . null) args)
+                         `catchIO` (\msg -> raiseIO ("error  : " ++ msg ++ "\ncommand: " ++ command ))
+       withMVar coutput $ \_ ->
+         do when (not (null out)) $ do { putStr out; hFlush stdout }
+            when (not (null err)) $ do { hPutStr stderr err; hFlush stderr }
+       when (not ok) $
+         raiseIO ("error  : command failed\ncommand: " ++ command)
+
+{-# NOINLINE coutput #-}
+coutput :: MVar ()
+coutput = unsafePerformIO (newMVar ())
+
 joinWith sep xs
   = concat (intersperse sep xs)
 
@@ -18,7 +18,7 @@ module Compiler.Options( -- * Command line options
                        , colorSchemeFromFlags
                        , prettyIncludePath
                        , isValueFromFlags
-                       , CC(..), BuildType(..), ccFlagsBuildFromFlags
+                       , CC(..), BuildType(..), Pgo(..), ccFlagsBuildFromFlags
                        , buildType, unquote
                        , outName, buildDir, buildVariant
                        , cpuArch, osName
@@ -31,7 +31,7 @@ import Data.List              ( intersperse )
 import Control.Monad          ( when )
 import qualified System.Info  ( os, arch )
 import System.Environment     ( getArgs )
-import System.Directory       ( doesFileExist, doesDirectoryExist, getHomeDirectory )
+import System.Directory       ( doesFileExist, doesDirectoryExist, getHomeDirectory, getCurrentDirectory )
 import Platform.GetOptions
 import Platform.Config
 import Lib.PPrint
@@ -96,6 +96,7 @@ data Flags
          , showCore         :: Bool
          , showFinalCore    :: Bool
          , showCoreTypes    :: Bool
+         , showSpecialize   :: Bool
          , showAsmCS        :: Bool
          , showAsmJS        :: Bool
          , showAsmC         :: Bool
@@ -166,6 +167,10 @@ data Flags
          , asan             :: Bool
          , useStdAlloc      :: Bool -- don't use mimalloc for better asan and valgrind support
          , optSpecialize    :: Bool
+         , pgo              :: Pgo
+         , lto              :: Bool
+         , ccompJobs        :: Int
+         , ccompCache       :: Bool
          }
 
 flagsNull :: Flags
@@ -175,6 +180,7 @@ flagsNull
           -- show
           False False  -- kinds kindsigs
           False False False False -- synonyms core fcore core-types
+          False -- specializations
           False -- show asm
           False
           False
@@ -249,6 +255,10 @@ flagsNull
           False -- use asan
           False -- use stdalloc
           True  -- use specialization (only used if optimization level >= 1)
+          PgoNone -- profile-guided optimization
+          False -- link-time optimization
+          1     -- parallel C compilation jobs
+          True  -- skip C compilation of unchanged modules
 
 isHelp Help = True
 isHelp _    = False
@@ -285,6 +295,7 @@ options = (\(xss,yss) -> (concat xss, concat yss)) $ unzip
  , flag   ['l'] ["library"]         (\b f -> f{library=b, evaluate=if b then False else (evaluate f) }) "generate a library"
  , numOption 0 "n" ['O'] ["optimize"]   (\i f -> f{optimize=i})     "optimize (0=default, 1=space, 2=full, 3=aggressive)"
  , flag   ['g'] ["debug"]           (\b f -> f{debug=b})            "emit debug information (on by default)"
+ , numOption 0 "n" ['j'] ["jobs"]   (\i f -> f{ccompJobs=i})        "run 'n' C compilations in parallel (0=#cores)"
  , emptyline
 
  , config []    ["target"]          [("c",C),("js",JS),("cs",CS)] "" targetFlag  "generate C (default), javascript, or C#"
@@ -302,6 +313,7 @@ options = (\(xss,yss) -> (concat xss, concat yss)) $ unzip
  , flag   []    ["showcore"]       (\b f -> f{showCore=b})          "show core"
  , flag   []    ["showfcore"]      (\b f -> f{showFinalCore=b})     "show final core (with backend optimizations)"
  , flag   []    ["showcoretypes"]  (\b f -> f{showCoreTypes=b})     "show full types in core"
+ , flag   []    ["showspec"]       (\b f -> f{showSpecialize=b})    "show the specializations that are taken"
  , flag   []    ["showcs"]         (\b f -> f{showAsmCS=b})         "show generated c#"
  , flag   []    ["showjs"]         (\b f -> f{showAsmJS=b})         "show generated javascript"
  , flag   []    ["showc"]          (\b f -> f{showAsmC=b})          "show generated C"
@@ -321,6 +333,9 @@ options = (\(xss,yss) -> (concat xss, concat yss)) $ unzip
  , option []    ["ccopts"]          (OptArg ccCompileArgs "opts")   "pass <opts> to C backend compiler "
  , option []    ["cclinkopts"]      (OptArg ccLinkArgs "opts")      "pass <opts> to C backend linker "
  , option []    ["cclibpath"]       (OptArg ccLinkLibs "lpath")     "link with semi-colon separated libraries <lpath>"
+ , option []    ["pgo"]             (ReqArg pgoFlag "mode")         "profile-guided optimization: <generate|use[:profile]>"
+ , flag   []    ["lto"]             (\b f -> f{ lto = b })           "whole program link-time optimization (including kklib)"
+ , flag   []    ["cchash"]          (\b f -> f{ ccompCache = b })    "skip C compilation of unchanged modules (default)"
  , option []    ["vcpkg"]           (ReqArg ccVcpkgRoot "dir")      "vcpkg root directory"
  , option []    ["vcpkgtriplet"]    (ReqArg ccVcpkgTriplet "tt")    "vcpkg target triplet"
  , flag   []    ["vcpkgauto"]       (\b f -> f{vcpkgAutoInstall=b}) "automatically install required vcpkg packages"
@@ -341,7 +356,7 @@ options = (\(xss,yss) -> (concat xss, concat yss)) $ unzip
  , hide $ fflag       ["parcreuse"] (\b f -> f{parcReuse=b})         "enable in-place update analysis"
  , hide $ fflag       ["parcspec"]  (\b f -> f{parcSpecialize=b})    "enable drop specialization"
  , hide $ fflag       ["parcrspec"] (\b f -> f{parcReuseSpec=b})     "enable reuse specialization"
- , hide $ fflag       ["binference"]    (\b f -> f{parcBorrowInference=b})     "enable reuse inference (does not work cross-module!)"
+ , hide $ fflag       ["binference"]    (\b f -> f{parcBorrowInference=b})     "enable borrow inference"
  , hide $ fflag       ["optctail"]  (\b f -> f{optctail=b})          "enable con-tail optimization (TRMC)"
  , hide $ fflag       ["optctailinline"]  (\b f -> f{optctailInline=b})  "enable con-tail inlining (increases code size)"
  , hide $ fflag       ["specialize"]  (\b f -> f{optSpecialize=b})      "enable inline specialization"
@@ -465,6 +480,13 @@ options = (\(xss,yss) -> (concat xss, concat yss)) $ unzip
     = Flag (\f -> f{ ccompLinkLibs = case mbs of
                                       Just s | not (null s) -> ccompLinkLibs f ++ undelimPaths s
                                       _ -> [] })
+  pgoFlag s
+    = case s of
+        "generate" -> Flag (\f -> f{ pgo = PgoGenerate })
+        "use"      -> Flag (\f -> f{ pgo = PgoUse "" })
+        'u':'s':'e':':':fpath | not (null fpath) -> Flag (\f -> f{ pgo = PgoUse fpath })
+        _          -> Error ("invalid value for --pgo option, expecting 'generate', 'use', or 'use:<profile>'")
+
   ccVcpkgRoot dir
     = Flag (\f -> f{vcpkgRoot = dir })
 
@@ -571,8 +593,9 @@ processOptions flags0 opts
                    ccmd <- if (ccompPath flags == "") then detectCC
                            else if (ccompPath flags == "mingw") then return "gcc"
                            else return (ccompPath flags)
-                   (cc,asan) <- ccFromPath flags ccmd
-                   ccCheckExist cc
+                   (cc0,asan) <- ccFromPath flags ccmd
+                   ccCheckExist cc0
+                   cc <- ccWithPgo flags (ccWithLto flags cc0)
                    let stdAlloc = if asan then True else useStdAlloc flags   -- asan implies useStdAlloc
                        cdefs    = ccompDefs flags 
                                    ++ if stdAlloc then [] else [("KK_MIMALLOC","")]
@@ -610,6 +633,7 @@ processOptions flags0 opts
                                   ccomp       = cc,
                                   ccompDefs   = cdefs,
                                   asan        = asan,
+                                  rebuild     = rebuild flags || pgo flags /= PgoNone,  -- all objects must be (re)compiled with the profile flags
                                   useStdAlloc = stdAlloc,
                                   editor      = ed,
                                   includePath = (localShareDir ++ "/lib") : includePath flags,
@@ -734,6 +758,9 @@ vcpkgFindRoot root
 
 type Args = [String]
 
+data Pgo = PgoNone | PgoGenerate | PgoUse FilePath
+         deriving Eq
+
 data CC = CC{  ccName       :: String,
                ccPath       :: FilePath,
                ccFlags      :: Args,
@@ -878,6 +905,54 @@ ccFromPath flags path
          then return (cc{ ccName = ccName cc ++ "-stdalloc" }, False)
          else return (cc,False)
 
+-- | Add the flags for link-time optimization. The build variant gets an `-lto` suffix
+-- so kklib is compiled from source with the same flags (instead of using the
+-- precompiled object) and the intermediate objects are never mixed with regular ones.
+ccWithLto :: Flags -> CC -> CC
+ccWithLto flags cc
+  | not (lto flags) = cc
+  | ccName cc `startsWith` "cl" && not (ccName cc `startsWith` "clang")   -- msvc
+      = cc{ ccName = ccName cc ++ "-lto"
+          , ccFlagsCompile = ccFlagsCompile cc ++ ["-GL"]
+          , ccFlagsLink    = ccFlagsLink cc ++ ["/LTCG"] }
+  | otherwise
+      = cc{ ccName = ccName cc ++ "-lto"
+          , ccFlagsCompile = ccFlagsCompile cc ++ ["-flto"]
+          , ccFlagsLink    = ccFlagsLink cc ++ ["-flto"] }
+
+-- | Add the flags for profile-guided optimization. With `--pgo=generate` an instrumented
+-- executable writes its profile to `<builddir>/pgo` when it runs (the training run);
+-- a subsequent build with `--pgo=use` reads the profile from there again.
+-- (For clang the raw profiles must first be merged into `<builddir>/pgo/default.profdata`
+-- using `llvm-profdata merge`, or passed explicitly as `--pgo=use:<profile>`.)
+-- Just like `ccWithLto`, the build variant gets a `-pgo` suffix so kklib is compiled
+-- from source with the profile flags instead of using the precompiled object.
+ccWithPgo :: Flags -> CC -> IO CC
+ccWithPgo flags cc0
+  = case pgo flags of
+      PgoNone -> return cc0
+      _ | not (ccName cc0 `startsWith` "clang" || ccName cc0 `startsWith` "gcc" || ccName cc0 `startsWith` "g++")
+        -> do putStrLn "warning: can only use profile-guided optimization with clang or gcc (--pgo is ignored)"
+              return cc0
+      PgoGenerate
+        -> do dir <- pgoDir
+              let gen = "-fprofile-generate=" ++ dir
+              return cc{ ccFlagsCompile = ccFlagsCompile cc ++ [gen]
+                       , ccFlagsLink    = ccFlagsLink cc ++ [gen] }
+      PgoUse fpath
+        -> do path <- if (null fpath) then pgoDir else return fpath
+              let use     = "-fprofile-use=" ++ path
+                  nowarn  = if (ccName cc `startsWith` "clang") then "-Wno-profile-instr-unprofiled" else "-Wno-missing-profile"
+              return cc{ ccFlagsCompile = ccFlagsCompile cc ++ [use,nowarn]
+                       , ccFlagsLink    = ccFlagsLink cc ++ [use] }
+  where
+    pgoDir = do let dir = joinPath (buildDir flags{ ccomp = cc }) "pgo"
+                if (isAbsolute dir) then return dir
+                  else do cwd <- getCurrentDirectory
+                          return (joinPath cwd dir)
+
+    cc = cc0{ ccName = ccName cc0 ++ "-pgo" }
+
 ccCheckExist :: CC -> IO ()
 ccCheckExist cc
   = do paths  <- getEnvPaths "PATH"
@@ -0,0 +1,186 @@
+-----------------------------------------------------------------------------
+-- Copyright 2021, Microsoft Research, Daan Leijen
+--
+-- This is free software; you can redistribute it and/or modify it under the
+-- terms of the Apache License, Version 2.0. A copy of the License can be
+-- found in the LICENSE file at the root of this distribution.
+-----------------------------------------------------------------------------
+
+-----------------------------------------------------------------------------
+-- Infer borrowed parameters of top-level functions.
+--
+-- A parameter can be borrowed if the function only inspects it: it is
+-- only matched on, or passed to borrowed parameters of other functions.
+-- The inferred parameter info is stored in the `DefFun` sort of a definition
+-- and thus ends up in the interface (as `^` annotations) so importing
+-- modules use the same calling convention (see `Core.Borrowed`).
+-- We keep a parameter owned if:
+-- - it is consumed (returned, stored, captured, bound, or passed as owned);
+-- - it is matched on while the function allocates (to enable reuse);
+-- - it is passed in a tail call to a function of the same recursive group
+--   where the argument would otherwise need a drop after the call.
+-----------------------------------------------------------------------------
+
+module Core.BorrowInference( borrowInference ) where
+
+import Data.Maybe( maybeToList )
+import qualified Data.Set as S
+import Common.Name
+import Common.Syntax( DefSort(..), ParamInfo(..) )
+import Core.Core
+import Core.CoreVar
+import Core.Borrowed
+
+borrowInference :: Borrowed -> CorePhase ()
+borrowInference borrowed0
+  = liftCorePhase $ \defs -> inferDefGroups borrowed0 defs
+
+
+{--------------------------------------------------------------------------
+  Definition groups
+--------------------------------------------------------------------------}
+
+inferDefGroups :: Borrowed -> DefGroups -> DefGroups
+inferDefGroups borrowed dgs
+  = case dgs of
+      []       -> []
+      (dg:dgs') -> let dg' = inferDefGroup borrowed dg
+                       borrowed' = borrowedExtends (extractBorrowDefs [dg']) borrowed
+                   in dg' : inferDefGroups borrowed' dgs'
+
+inferDefGroup :: Borrowed -> DefGroup -> DefGroup
+inferDefGroup borrowed dg
+  = case dg of
+      DefNonRec def -> DefNonRec (inferDefs borrowed [] [def] !! 0)
+      DefRec defs   -> DefRec (inferDefs borrowed (map defName defs) defs)
+
+-- Iterate to a fixpoint: we start by assuming all parameters of the
+-- candidates are borrowed, and only ever change parameters to owned.
+inferDefs :: Borrowed -> [Name] -> [Def] -> [Def]
+inferDefs borrowed0 group defs
+  = iter (map initial defs)
+  where
+    borrowed = borrowedExtends (concatMap (maybeToList . extractBorrowDef True) defs) borrowed0
+
+    iter cdefs
+      = let borrowedG = borrowedExtends [(defName def,pinfos) | (def,Just pinfos) <- cdefs] borrowed
+            usages    = [maybe usageEmpty (usageDef borrowedG group def) mbp | (def,mbp) <- cdefs]
+            tailOwn   = concatMap usageTailOwned usages
+            cdefs'    = [(def, fmap (\pinfos -> paramInfos def pinfos u tailOwn) mbp) | ((def,mbp),u) <- zip cdefs usages]
+        in if (map snd cdefs == map snd cdefs')
+            then map finalize cdefs'
+            else iter cdefs'
+
+    initial def
+      = case (defSort def, lamParams (defExpr def)) of
+          (DefFun [], Just pars) | not (null pars) -> (def, Just (map (const Borrow) pars))
+          _ -> (def, Nothing)
+
+    paramInfos def pinfos u tailOwn
+      = [if (pinfo == Own || S.member par (usageConsumed u) ||
+             (usageAllocates u && S.member par (usageScrutinized u)) ||
+             (defName def, i) `elem` tailOwn)
+          then Own else Borrow
+        | (i,par,pinfo) <- zip3 [0..] (maybe [] id (lamParams (defExpr def))) pinfos]
+
+    finalize (def,mbp)
+      = case mbp of
+          Just pinfos | Borrow `elem` pinfos -> def{ defSort = DefFun pinfos }
+          _ -> def
+
+lamParams :: Expr -> Maybe [TName]
+lamParams expr
+  = case expr of
+      TypeLam _ body   -> lamParams body
+      Lam pars _ _     -> Just pars
+      _                -> Nothing
+
+
+{--------------------------------------------------------------------------
+  Usage of parameters
+--------------------------------------------------------------------------}
+
+data Usage = Usage{ usageConsumed    :: TNames        -- locals used in an owned position
+                  , usageScrutinized :: TNames        -- locals that are matched on
+                  , usageAllocates   :: Bool          -- does the function allocate constructors?
+                  , usageTailOwned   :: [(Name,Int)]  -- parameters of group members that must be owned
+                  }
+
+usageEmpty :: Usage
+usageEmpty = Usage S.empty S.empty False []
+
+usageJoin :: Usage -> Usage -> Usage
+usageJoin (Usage c1 s1 a1 t1) (Usage c2 s2 a2 t2)
+  = Usage (S.union c1 c2) (S.union s1 s2) (a1 || a2) (t1 ++ t2)
+
+usageJoins :: [Usage] -> Usage
+usageJoins us = foldr usageJoin usageEmpty us
+
+consume :: TNames -> Usage
+consume tnames = usageEmpty{ usageConsumed = tnames }
+
+data Env = Env{ borrowed :: Borrowed
+              , group    :: [Name]
+              , borrows  :: TNames   -- locals that are borrowed: borrowed parameters and the variables bound by matching on them
+              }
+
+usageDef :: Borrowed -> [Name] -> Def -> [ParamInfo] -> Usage
+usageDef borrowed group def pinfos
+  = case lamBody (defExpr def) of
+      Just (pars,body) -> usage (Env borrowed group (S.fromList [par | (par,Borrow) <- zip pars pinfos])) True body
+      Nothing          -> usageEmpty
+  where
+    lamBody expr
+      = case expr of
+          TypeLam _ body  -> lamBody body
+          Lam pars _ body -> Just (pars,body)
+          _               -> Nothing
+
+usage :: Env -> Bool -> Expr -> Usage
+usage env isTail expr
+  = case expr of
+      Var tname _       -> consume (S.singleton tname)
+      Lam _ _ _         -> consume (freeLocals expr)
+      TypeLam _ body    -> usage env isTail body
+      TypeApp body _    -> usage env isTail body
+      Lit _             -> usageEmpty
+      Con _ _           -> usageEmpty
+      App (Con _ _) args              -> allocates (usageArgs args)
+      App (TypeApp (Con _ _) _) args  -> allocates (usageArgs args)
+      App (Var tname _) args               -> usageApp tname args
+      App (TypeApp (Var tname _) _) args   -> usageApp tname args
+      App f args        -> usageJoins (usage env False f : map (usage env False) args)
+      Let dgs body      -> usageJoins (usage env isTail body : [usage env False (defExpr def) | def <- flattenDefGroups dgs])
+      Case scruts brs   -> usageJoins (map usageScrut scruts ++ map (usageBranch scruts) brs)
+  where
+    usageArgs args = usageJoins (map (usage env False) args)
+    allocates u    = u{ usageAllocates = True }
+
+    usageApp tname args
+      = let pinfos = maybe [] id (borrowedLookup (getName tname) (borrowed env)) ++ repeat Own
+            fu     = if (isQualified (getName tname)) then usageEmpty  -- calling a local function consumes it
+                      else consume (S.singleton tname)
+            argUsage (arg,pinfo)
+              = case (arg,pinfo) of
+                  (Var _ _, Borrow) -> usageEmpty
+                  _                 -> usage env False arg
+            tailOwn
+              = if (isTail && getName tname `elem` group env)
+                 then [(getName tname,i) | (i,arg,Borrow) <- zip3 [0..] args pinfos, not (isBorrowedVar arg)]
+                 else []
+        in usageJoins (usageEmpty{ usageTailOwned = tailOwn } : fu : map argUsage (zip args pinfos))
+
+    isBorrowedVar arg
+      = case arg of
+          Var tname _ -> S.member tname (borrows env)
+          _           -> False
+
+    usageScrut scrut
+      = case scrut of
+          Var tname _ -> usageEmpty{ usageScrutinized = S.singleton tname }
+          _           -> usage env False scrut
+
+    usageBranch scruts (Branch pats guards)
+      = let bvars  = S.unions [bv pat | (Var tname _, pat) <- zip scruts pats, S.member tname (borrows env)]
+            env'   = env{ borrows = S.union bvars (borrows env) }
+        in usageJoins [usageJoin (usage env' False test) (usage env' isTail body) | Guard test body <- guards]
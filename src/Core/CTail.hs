@@ -65,6 +65,8 @@ ctailDefGroup topLevel dg
   = case dg of
       DefRec [def] | hasCTailCall (defTName def) True (defExpr def)
         -> ctailDef topLevel def
+      DefRec [def] | Just op <- hasAccTailCall (defTName def) (defExpr def)
+        -> accDef op def
       _ -> return [dg]
 
 
@@ -358,6 +360,147 @@ ctailFoundArg cname mbC mkConsApp field mkTailApp resTp -- f fargs
                                     ,ctailCall)
 
 
+--------------------------------------------------------------------------
+-- Tail recursion modulo an associative operator.
+-- For integer addition and multiplication we pass an accumulator instead:
+--
+--   fun count(xs) { match(xs) { Cons(_,xx) -> 1 + count(xx); Nil -> 0 } }
+-- ~>
+--   fun count(xs) { count-acc(xs,0) }
+--   fun count-acc(xs,acc) { match(xs) { Cons(_,xx) -> count-acc(xx,acc + 1); Nil -> acc + 0 } }
+--
+-- This is valid since these operators are associative and commutative,
+-- and we only do this if the other operand is total (so it can be
+-- evaluated before the recursive call). Since the accumulator is an
+-- immutable value this also works for operations that resume more than once.
+--
+-- Only integer `+` and `*` are handled. A recursive call under a tuple (as in
+-- `unzip` or `partition`) would need a context with multiple holes and is left
+-- as is. (A call in a non-last constructor field is already handled by the
+-- constructor contexts above as long as the later fields are total.)
+--------------------------------------------------------------------------
+
+data AccOp = AccOp{ accOpExpr :: Expr, accOpUnit :: Integer }
+
+hasAccTailCall :: TName -> Expr -> Maybe AccOp
+hasAccTailCall defName expr
+  = case expr of
+      TypeLam _ (Lam _ _ body) -> hasOps body
+      Lam _ _ body             -> hasOps body
+      _                        -> Nothing
+  where
+    hasOps body
+      = case accTailOps defName body of
+          ops@(op:_) | all (\op' -> accOpName op' == accOpName op) ops -> Just op
+          _ -> Nothing
+
+-- all the operators applied to a recursive call in a result position
+accTailOps :: TName -> Expr -> [AccOp]
+accTailOps defName expr
+  = case expr of
+      Let _ body      -> accTailOps defName body
+      Case _ branches -> concat [accTailOps defName body | Branch _ guards <- branches, Guard _ body <- guards]
+      App f [x,y]     | Just op <- accOperator f, Just _ <- splitAccOperand defName x y
+                      -> [op]
+      _ -> []
+
+accOperator :: Expr -> Maybe AccOp
+accOperator expr
+  = case expr of
+      Var tname _ | isIntOp (typeOf tname)
+        -> let name = nonCanonicalName (getName tname)
+           in if (name == qualify nameSystemCore (newName "+")) then Just (AccOp expr 0)
+              else if (name == qualify nameSystemCore (newName "*")) then Just (AccOp expr 1)
+              else Nothing
+      _ -> Nothing
+  where
+    isIntOp tp
+      = case splitFunScheme tp of
+          Just ([],[],[(_,t1),(_,t2)],_,tres) -> all isTypeInt [t1,t2,tres]
+          _ -> False
+
+accOpName :: AccOp -> Name
+accOpName op
+  = case accOpExpr op of
+      Var tname _ -> getName tname
+      _           -> nameNil
+
+-- split into the operand and the recursive call
+splitAccOperand :: TName -> Expr -> Expr -> Maybe (Expr,Expr)
+splitAccOperand defName x y
+  | isSelfCall defName y && isOperand x = Just (x,y)
+  | isSelfCall defName x && isOperand y = Just (y,x)
+  | otherwise                           = Nothing
+  where
+    isOperand e = isTotal e && not (tnamesMember defName (fv e))
+
+isSelfCall :: TName -> Expr -> Bool
+isSelfCall defName expr
+  = case expr of
+      App (TypeApp (Var name _) _) _ -> name == defName
+      App (Var name _) _             -> name == defName
+      _                              -> False
+
+
+accDef :: AccOp -> Def -> CTail [DefGroup]
+accDef op def
+  = withCurrentDef def $
+    case splitFunScheme (defType def) of
+      Nothing -> return [DefRec [def]]
+      Just (tforall,tpreds,targs,teff,tres)
+        -> do let accName  = makeHiddenName "ctailacc" (defName def)
+                  accSlot  = TName (newHiddenName "acc") typeInt
+                  accType  = tForall tforall tpreds (TFun (targs ++ [(getName accSlot,typeInt)]) teff tres)
+                  accTName = TName accName accType
+              accExpr  <- withContext accTName False (Just accSlot) $
+                          accBody op (makeCDefExpr accSlot (defExpr def))
+              wrapExpr <- withContext accTName False Nothing $
+                          accWrapper op (defExpr def)
+              let adef = def{ defName = accName, defType = accType, defExpr = accExpr }
+              return [DefRec [adef, def{ defExpr = wrapExpr }]]
+
+accWrapper :: AccOp -> Expr -> CTail Expr
+accWrapper op expr
+  = case expr of
+      TypeLam targs (Lam pars eff body)
+        -> TypeLam targs . Lam pars eff <$> wrapperCall [TVar tv | tv <- targs] pars
+      Lam pars eff body
+        -> Lam pars eff <$> wrapperCall [] pars
+      _ -> failure $ "Core.CTail.accWrapper: illegal function shape: " ++ show expr
+  where
+    wrapperCall targs pars
+      = do accVar <- getCTailFun
+           return (App (makeTypeApp accVar targs) ([Var par InfoNone | par <- pars] ++ [Lit (LitInt (accOpUnit op))]))
+
+accBody :: AccOp -> Expr -> CTail Expr
+accBody op expr
+  = do dname   <- getCurrentDefName
+       mbSlot  <- getCTailSlot
+       let acc = case mbSlot of
+                   Just slot -> Var slot InfoNone
+                   Nothing   -> failure "Core.CTail.accBody: no accumulator"
+           accApply x = App (accOpExpr op) [acc,x]
+           accCall call accArg
+             = do accVar <- getCTailFun
+                  return $ case call of
+                    App (TypeApp _ targs) args -> App (TypeApp accVar targs) (args ++ [accArg])
+                    App _ args                 -> App accVar (args ++ [accArg])
+                    _                          -> failure "Core.CTail.accBody: illegal call"
+           visit body
+             = case body of
+                 TypeLam tpars e -> TypeLam tpars <$> visit e
+                 Lam pars eff e  -> Lam pars eff <$> visit e
+                 Let dgs e       -> Let dgs <$> visit e
+                 Case xs branches
+                   -> Case xs <$> mapM (\(Branch pats guards) -> Branch pats <$> mapM (\(Guard test e) -> Guard test <$> visit e) guards) branches
+                 App f [x,y]     | fmap accOpName (accOperator f) == Just (accOpName op),
+                                   Just (operand,call) <- splitAccOperand dname x y
+                   -> accCall call (accApply operand)
+                 _ | isSelfCall dname body
+                   -> accCall body acc
+                 _ -> return (accApply body)
+       visit expr
+
 --------------------------------------------------------------------------
 -- Primitives
 --------------------------------------------------------------------------
@@ -12,6 +12,7 @@ module Core.Specialize( specialize
 import Data.List (transpose )
 import Control.Monad.State
 import Control.Monad.Reader
+import Control.Monad.Writer
 import Control.Arrow ((***))
 import Data.Monoid((<>))
 import Data.Maybe (mapMaybe, fromMaybe, catMaybes, isJust, fromJust)
@@ -40,21 +41,26 @@ import Core.Uniquefy
   Specialization Monad
 --------------------------------------------------------------------------}
 
-type SpecM = Reader Inlines
+-- | We collect a report line for each specialization that is taken
+type SpecM = ReaderT Inlines (Writer [String])
 
-runSpecM :: Inlines -> SpecM a -> a
-runSpecM specEnv specM = runReader specM specEnv
+runSpecM :: Inlines -> SpecM a -> (a,[String])
+runSpecM specEnv specM = runWriter (runReaderT specM specEnv)
 
 
 {--------------------------------------------------------------------------
   Specialization
 --------------------------------------------------------------------------}
 
-specialize :: Inlines -> CorePhase ()
-specialize specEnv
-  = liftCorePhase $ \defs ->
-    -- TODO: use uniqe int to generate names and remove call to uniquefyDefGroups?
-    uniquefyDefGroups $ runSpecM specEnv (mapM specOneDefGroup defs)
+-- | Specialize the definitions and return a report of the specializations that were
+-- taken (shown with `-v2` or `--showspec` by the compiler).
+specialize :: Inlines -> CorePhase [String]
+specialize inlines
+  = do defs <- getCoreDefs
+       let (defs',report) = runSpecM inlines (mapM specOneDefGroup defs)
+       -- TODO: use uniqe int to generate names and remove call to uniquefyDefGroups?
+       setCoreDefs (uniquefyDefGroups defs')
+       return report
 
 speclookupM :: Name -> SpecM (Maybe InlineDef)
 speclookupM name
@@ -87,7 +93,7 @@ specOneExpr thisDefName
             case mbSpecDef of
               Nothing -> pure e
               Just specDef
-                | inlineName specDef /= thisDefName -> specOneCall specDef e   -- don't specialize ourselves
+                | inlineName specDef /= thisDefName -> specOneCall thisDefName specDef e   -- don't specialize ourselves
                 | otherwise -> pure e
 
 filterBools :: [Bool] -> [a] -> [a]
@@ -102,16 +108,21 @@ partitionBools bools as = foldr f ([], []) $ zip bools as
       | bool = (falses, a : trues)
       | otherwise = (a : falses, trues)
 
-specOneCall :: InlineDef -> Expr -> SpecM Expr
-specOneCall (InlineDef{ inlineName=specName, inlineExpr=specExpr, specializeArgs=specArgs }) e
+specOneCall :: Name -> InlineDef -> Expr -> SpecM Expr
+specOneCall thisDefName (InlineDef{ inlineName=specName, inlineExpr=specExpr, specializeArgs=specArgs }) e
   = case e of
       App (Var (TName name _) _) args  | goodArgs args
-        -> replaceCall specName specExpr specArgs args Nothing
+        -> reportSpec $ replaceCall specName specExpr specArgs args Nothing
       App (TypeApp (Var (TName name ty) _) typeArgs) args  | goodArgs args
-        -> replaceCall specName specExpr specArgs args $ Just typeArgs      
+        -> reportSpec $ replaceCall specName specExpr specArgs args $ Just typeArgs      
       _ -> return e
 
   where
+    reportSpec action
+      = do tell ["specialize: " ++ show thisDefName ++ ": " ++ show specName ++ " on parameters "
+                 ++ show (map getName (filterBools specArgs (fnParams specExpr)))]
+           action
+
     goodArgs args  = -- (\isgoodarg -> trace (show args ++ " is " ++ (if isgoodarg then "" else "not ") ++ "good") isgoodarg) $
       all goodArg $ filterBools specArgs args
     goodArg expr = case expr of
@@ -0,0 +1,33 @@
+// Count the words of a generated text with a `std::unordered_map`
+// (the same workload as `koka/wordcount.kk`).
+#include <iostream>
+#include <string>
+#include <unordered_map>
+
+// the words are drawn from 100000 distinct words using a linear congruential generator
+static long next_rand(long x) {
+  return (x * 1103515245 + 12345) % 2147483648;
+}
+
+static std::string word(long x) {
+  return "w" + std::to_string((x / 256) % 100000);
+}
+
+int main(int argc, char ** argv) {
+  long n = 4200000;
+  if (argc == 2) {
+    n = atol(argv[1]);
+  }
+  std::unordered_map<std::string,long> counts;
+  long x = 1;
+  for (long i = 0; i < n; i++) {
+    counts[word(x)]++;
+    x = next_rand(x);
+  }
+  long top = 0;
+  for (const auto& wc : counts) {
+    if (wc.second > top) top = wc.second;
+  }
+  std::cout << counts.size() << "\n" << top << "\n";
+  return 0;
+}